@@ -0,0 +1,64 @@
+#pragma once
+#include "Commons.h"
+
+// blocking fifo with a fixed capacity, producers wait while it is full
+// and consumers wait while it is empty until the queue gets closed
+template<typename T>
+class BoundedQueue {
+    private:
+        std::deque<T> items;
+        std::mutex mutex;
+        std::condition_variable notFull;
+        std::condition_variable notEmpty;
+        size_t capacity;
+        bool closed;
+    public:
+        BoundedQueue(size_t capacity) : capacity(std::max<size_t>(1, capacity)), closed(false) {}
+
+        void push(const T &item)
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            notFull.wait(lock, [this] { return closed || items.size() < capacity; });
+
+            if (closed) return;
+
+            items.push_back(item);
+            notEmpty.notify_one();
+        }
+
+        // returns false once the queue is closed and drained
+        bool pop(T &item)
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            notEmpty.wait(lock, [this] { return closed || !items.empty(); });
+
+            if (items.empty()) return false;
+
+            item = items.front();
+            items.pop_front();
+            notFull.notify_one();
+            return true;
+        }
+
+        // pop that returns false instead of waiting on an empty queue
+        bool tryPop(T &item)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            if (items.empty()) return false;
+
+            item = items.front();
+            items.pop_front();
+            notFull.notify_one();
+            return true;
+        }
+
+        void close()
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            closed = true;
+            notFull.notify_all();
+            notEmpty.notify_all();
+        }
+};
+
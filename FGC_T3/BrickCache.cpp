@@ -0,0 +1,69 @@
+#include "BrickCache.h"
+
+BrickCache::BrickCache(void)
+{
+    capacityBytes = 0;
+    usedBytes = 0;
+}
+
+BrickCache::~BrickCache(void)
+{
+}
+
+BrickCache::Data BrickCache::get(int brick)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = lookup.find(brick);
+
+    if (it == lookup.end()) return Data();
+
+    entries.splice(entries.begin(), entries, it->second);
+    return it->second->second;
+}
+
+bool BrickCache::contains(int brick) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return lookup.find(brick) != lookup.end();
+}
+
+void BrickCache::put(int brick, const Data &data)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = lookup.find(brick);
+
+    if (it != lookup.end()) {
+        usedBytes -= it->second->second->size();
+        entries.erase(it->second);
+    }
+
+    entries.push_front(std::make_pair(brick, data));
+    lookup[brick] = entries.begin();
+    usedBytes += data->size();
+    evict();
+}
+
+void BrickCache::setCapacity(size_t bytes)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    capacityBytes = bytes;
+    evict();
+}
+
+void BrickCache::clear()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    entries.clear();
+    lookup.clear();
+    usedBytes = 0;
+}
+
+void BrickCache::evict()
+{
+    // the newest entry always stays, even over the budget
+    while (usedBytes > capacityBytes && entries.size() > 1) {
+        usedBytes -= entries.back().second->size();
+        lookup.erase(entries.back().first);
+        entries.pop_back();
+    }
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include "Commons.h"
+
+// least recently used store of brick voxels with a fixed memory budget,
+// shared by the thread reading bricks and the one uploading them
+class BrickCache {
+    public:
+        typedef std::shared_ptr<const std::vector<unsigned char>> Data;
+
+    private:
+        typedef std::list<std::pair<int, Data>> Entries;
+        // most recently used first
+        Entries entries;
+        std::unordered_map<int, Entries::iterator> lookup;
+        size_t capacityBytes;
+        size_t usedBytes;
+        mutable std::mutex mutex;
+
+        void evict();
+
+        BrickCache(const BrickCache &);
+        BrickCache &operator=(const BrickCache &);
+    public:
+        // null when the brick isn't cached, marks it as recently used
+        Data get(int brick);
+        bool contains(int brick) const;
+        void put(int brick, const Data &data);
+        void setCapacity(size_t bytes);
+        void clear();
+
+        size_t size() const
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            return usedBytes;
+        }
+
+        BrickCache(void);
+        ~BrickCache(void);
+};
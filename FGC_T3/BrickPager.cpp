@@ -0,0 +1,275 @@
+#include "BrickPager.h"
+
+BrickPager::BrickPager(void)
+{
+    volume = nullptr;
+    voxelType = VolumeData::UInt8;
+    gridSize = poolSlots = glm::ivec3(0);
+    brickSize = slotSize = 0;
+    slotBytes = 0;
+    poolTexture = pageTableTexture = 0;
+    pageTableDirty = false;
+    frame = 0;
+    stopping = false;
+}
+
+BrickPager::~BrickPager(void)
+{
+    release();
+}
+
+bool BrickPager::init(const BrickedVolume &volume, size_t poolBytes, size_t cacheBytes, int maxTextureSize)
+{
+    release();
+    const BrickedVolume::Header &header = volume.getHeader();
+    voxelType = (VolumeData::VoxelType)header.voxelType;
+    brickSize = header.brickSize;
+    slotSize = brickSize + 2;
+    slotBytes = (size_t)slotSize * slotSize * slotSize * VolumeData::bytesPerVoxel(voxelType);
+    gridSize = volume.levelBricks(0);
+    int brickCount = gridSize.x * gridSize.y * gridSize.z;
+    // page table entries hold 8 bit slot coordinates
+    int perAxis = std::min(255, maxTextureSize / slotSize);
+    size_t slots = std::min(poolBytes / slotBytes, (size_t)brickCount);
+
+    if (slots == 0 || perAxis == 0) {
+        std::cout << "Error: the gpu budget can't hold a single brick" << std::endl;
+        return false;
+    }
+
+    poolSlots.x = glm::clamp((int)std::cbrt((double)slots), 1, perAxis);
+    poolSlots.y = glm::clamp((int)std::sqrt((double)slots / poolSlots.x), 1, perAxis);
+    poolSlots.z = glm::clamp((int)(slots / (poolSlots.x * poolSlots.y)), 1, perAxis);
+    int slotCount = poolSlots.x * poolSlots.y * poolSlots.z;
+    this->volume = &volume;
+    grid.assign(brickCount, nullptr);
+
+    for (unsigned int i = 0; i < header.brickCount; i++) {
+        const BrickedVolume::BrickInfo &brick = volume.getIndex()[i];
+
+        if (brick.level == 0) grid[brick.x + (brick.y + brick.z * gridSize.y) * gridSize.x] = &brick;
+    }
+
+    slotBrick.assign(slotCount, -1);
+    slotUsed.assign(slotCount, 0);
+    freeSlots.clear();
+
+    for (int s = slotCount - 1; s >= 0; s--) freeSlots.push_back(s);
+
+    brickSlot.assign(brickCount, -1);
+    pageTable.assign((size_t)brickCount * 4, 0);
+    pageTableDirty = false;
+    priority.clear();
+    lastEye = glm::vec3(std::numeric_limits<float>::max());
+    frame = 0;
+    cache.setCapacity(cacheBytes);
+    // brick pool, linear filtering works across the slot borders
+    glm::ivec3 poolSize = getPoolSize();
+    glGenTextures(1, &poolTexture);
+    glBindTexture(GL_TEXTURE_3D, poolTexture);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    glTexImage3D(GL_TEXTURE_3D, 0, VolumeData::glInternalFormat(voxelType), poolSize.x, poolSize.y, poolSize.z, 0, GL_RED,
+                 VolumeData::glType(voxelType), nullptr);
+    // page table, one texel per brick
+    glGenTextures(1, &pageTableTexture);
+    glBindTexture(GL_TEXTURE_3D, pageTableTexture);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage3D(GL_TEXTURE_3D, 0, GL_RGBA8UI, gridSize.x, gridSize.y, gridSize.z, 0, GL_RGBA_INTEGER, GL_UNSIGNED_BYTE, &pageTable[0]);
+    stopping = false;
+    reader = std::thread(&BrickPager::readerLoop, this);
+    std::cout << "brick pool of " << slotCount << " slots for " << brickCount << " bricks" << std::endl;
+    return true;
+}
+
+void BrickPager::release()
+{
+    if (reader.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(requestMutex);
+            stopping = true;
+            requests.clear();
+        }
+        requestReady.notify_one();
+        reader.join();
+    }
+
+    if (poolTexture != 0) glDeleteTextures(1, &poolTexture);
+
+    if (pageTableTexture != 0) glDeleteTextures(1, &pageTableTexture);
+
+    poolTexture = pageTableTexture = 0;
+    cache.clear();
+    grid.clear();
+    slotBrick.clear();
+    slotUsed.clear();
+    freeSlots.clear();
+    brickSlot.clear();
+    pageTable.clear();
+    priority.clear();
+    volume = nullptr;
+}
+
+void BrickPager::readerLoop()
+{
+    while (true) {
+        int brick;
+        {
+            std::unique_lock<std::mutex> lock(requestMutex);
+            requestReady.wait(lock, [this] { return stopping || !requests.empty(); });
+
+            if (stopping) return;
+
+            brick = requests.front();
+            requests.pop_front();
+        }
+
+        if (cache.contains(brick)) continue;
+
+        std::shared_ptr<std::vector<unsigned char>> voxels(new std::vector<unsigned char>());
+        readBrick(brick, *voxels);
+        cache.put(brick, voxels);
+    }
+}
+
+void BrickPager::readBrick(int brick, std::vector<unsigned char> &dst) const
+{
+    size_t voxelBytes = VolumeData::bytesPerVoxel(voxelType);
+    glm::ivec3 size = volume->levelSize(0);
+    glm::ivec3 origin = glm::ivec3(brick % gridSize.x, (brick / gridSize.x) % gridSize.y, brick / (gridSize.x * gridSize.y)) * brickSize;
+    // voxels past the volume edge repeat the edge
+    auto voxelAt = [&](const glm::ivec3 & position) {
+        glm::ivec3 p = glm::clamp(position, glm::ivec3(0), size - glm::ivec3(1));
+        glm::ivec3 b = p / brickSize, local = p - b * brickSize;
+        const BrickedVolume::BrickInfo *info = grid[b.x + (b.y + b.z * gridSize.y) * gridSize.x];
+        size_t index = local.x + (local.y + (size_t)local.z * brickSize) * brickSize;
+        return (const unsigned char *)volume->brickData(*info) + index * voxelBytes;
+    };
+    dst.resize(slotBytes);
+    unsigned char *out = &dst[0];
+
+    for (int z = -1; z <= brickSize; z++) {
+        for (int y = -1; y <= brickSize; y++) {
+            // the row itself is contiguous in one brick, only the ends come from the x neighbours
+            memcpy(out, voxelAt(origin + glm::ivec3(-1, y, z)), voxelBytes);
+            out += voxelBytes;
+            memcpy(out, voxelAt(origin + glm::ivec3(0, y, z)), brickSize * voxelBytes);
+            out += brickSize * voxelBytes;
+            memcpy(out, voxelAt(origin + glm::ivec3(brickSize, y, z)), voxelBytes);
+            out += voxelBytes;
+        }
+    }
+}
+
+void BrickPager::prioritize(const glm::vec3 &eye, const glm::vec3 &scale)
+{
+    glm::vec3 size = glm::vec3(volume->levelSize(0));
+    std::vector<float> distance(grid.size(), 0.f);
+    lastEye = eye;
+    priority.clear();
+
+    for (int b = 0; b < (int)grid.size(); b++) {
+        // all zero bricks are left to the coarse level
+        if (!grid[b] || grid[b]->max <= 0.f) continue;
+
+        glm::vec3 center = (glm::vec3(grid[b]->x, grid[b]->y, grid[b]->z) + 0.5f) * (float)brickSize / size;
+        distance[b] = glm::length((center - eye) * scale);
+        priority.push_back(b);
+    }
+
+    std::sort(priority.begin(), priority.end(), [&](int a, int b) {
+        return distance[a] < distance[b];
+    });
+}
+
+int BrickPager::acquireSlot()
+{
+    if (!freeSlots.empty()) {
+        int slot = freeSlots.back();
+        freeSlots.pop_back();
+        return slot;
+    }
+
+    int oldest = 0;
+
+    for (int s = 1; s < (int)slotUsed.size(); s++) {
+        if (slotUsed[s] < slotUsed[oldest]) oldest = s;
+    }
+
+    int evicted = slotBrick[oldest];
+    brickSlot[evicted] = -1;
+    pageTable[evicted * 4 + 3] = 0;
+    pageTableDirty = true;
+    slotBrick[oldest] = -1;
+    return oldest;
+}
+
+void BrickPager::upload(int brick, int slot, const std::vector<unsigned char> &voxels)
+{
+    glm::ivec3 s(slot % poolSlots.x, (slot / poolSlots.x) % poolSlots.y, slot / (poolSlots.x * poolSlots.y));
+    glTexSubImage3D(GL_TEXTURE_3D, 0, s.x * slotSize, s.y * slotSize, s.z * slotSize, slotSize, slotSize, slotSize, GL_RED,
+                    VolumeData::glType(voxelType), &voxels[0]);
+    slotBrick[slot] = brick;
+    slotUsed[slot] = frame;
+    brickSlot[brick] = slot;
+    pageTable[brick * 4 + 0] = (unsigned char)s.x;
+    pageTable[brick * 4 + 1] = (unsigned char)s.y;
+    pageTable[brick * 4 + 2] = (unsigned char)s.z;
+    pageTable[brick * 4 + 3] = 255;
+    pageTableDirty = true;
+}
+
+void BrickPager::update(const glm::vec3 &eye, const glm::vec3 &scale)
+{
+    if (!isActive()) return;
+
+    frame++;
+
+    // resorting every frame is too slow for large grids, small moves keep the order
+    if (glm::distance(eye, lastEye) > 0.02f) prioritize(eye, scale);
+
+    size_t wanted = std::min(priority.size(), slotBrick.size());
+
+    // resident bricks are marked first so none of them is evicted for a farther one
+    for (size_t i = 0; i < wanted; i++) {
+        if (brickSlot[priority[i]] >= 0) slotUsed[brickSlot[priority[i]]] = frame;
+    }
+
+    std::deque<int> missing;
+    int uploads = 0;
+    glBindTexture(GL_TEXTURE_3D, poolTexture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    for (size_t i = 0; i < wanted; i++) {
+        int brick = priority[i];
+
+        if (brickSlot[brick] >= 0) continue;
+
+        BrickCache::Data voxels = uploads < MAX_UPLOADS_PER_FRAME ? cache.get(brick) : BrickCache::Data();
+
+        if (voxels) {
+            upload(brick, acquireSlot(), *voxels);
+            uploads++;
+        } else if (!cache.contains(brick)) {
+            missing.push_back(brick);
+        }
+    }
+
+    // the reader always works on the nearest bricks of the latest view
+    {
+        std::lock_guard<std::mutex> lock(requestMutex);
+        requests.swap(missing);
+    }
+    requestReady.notify_one();
+
+    if (pageTableDirty) {
+        glBindTexture(GL_TEXTURE_3D, pageTableTexture);
+        glTexSubImage3D(GL_TEXTURE_3D, 0, 0, 0, 0, gridSize.x, gridSize.y, gridSize.z, GL_RGBA_INTEGER, GL_UNSIGNED_BYTE, &pageTable[0]);
+        pageTableDirty = false;
+    }
+}
@@ -0,0 +1,93 @@
+#pragma once
+#include "Commons.h"
+#include "BrickedVolume.h"
+#include "BrickCache.h"
+
+// pages the finest level of a bricked volume through a fixed size brick
+// pool texture. a page table texture holds, per brick, the pool slot it
+// lives in so the shader can find it, bricks that aren't resident fall
+// back to a coarser level. bricks are read on a background thread into a
+// cpu cache in the order the current view needs them
+class BrickPager {
+    private:
+        const BrickedVolume *volume;
+        VolumeData::VoxelType voxelType;
+        // level 0 bricks per axis and their index entries
+        glm::ivec3 gridSize;
+        std::vector<const BrickedVolume::BrickInfo *> grid;
+        int brickSize;
+        // bricks are stored in the pool with a one voxel border
+        int slotSize;
+        size_t slotBytes;
+        // gpu side
+        GLuint poolTexture;
+        GLuint pageTableTexture;
+        glm::ivec3 poolSlots;
+        // brick in each slot, -1 for free slots
+        std::vector<int> slotBrick;
+        std::vector<int> freeSlots;
+        // frame each slot was last needed, the oldest is evicted first
+        std::vector<unsigned int> slotUsed;
+        // slot of each brick, -1 when not resident
+        std::vector<int> brickSlot;
+        // rgba8ui per brick, slot coordinates and a resident flag
+        std::vector<unsigned char> pageTable;
+        bool pageTableDirty;
+        unsigned int frame;
+        // non empty bricks, nearest to the eye first
+        std::vector<int> priority;
+        glm::vec3 lastEye;
+        // cpu side
+        BrickCache cache;
+        std::thread reader;
+        std::mutex requestMutex;
+        std::condition_variable requestReady;
+        std::deque<int> requests;
+        bool stopping;
+
+        void readerLoop();
+        // brick voxels plus the border taken from its neighbours
+        void readBrick(int brick, std::vector<unsigned char> &dst) const;
+        void prioritize(const glm::vec3 &eye, const glm::vec3 &scale);
+        int acquireSlot();
+        void upload(int brick, int slot, const std::vector<unsigned char> &voxels);
+
+        BrickPager(const BrickPager &);
+        BrickPager &operator=(const BrickPager &);
+    public:
+        static const int MAX_UPLOADS_PER_FRAME = 32;
+
+        // poolBytes of gpu memory for bricks, cacheBytes of ram for bricks read ahead
+        bool init(const BrickedVolume &volume, size_t poolBytes, size_t cacheBytes, int maxTextureSize);
+        void release();
+        // eye in normalized volume coordinates, scale the physical volume size
+        void update(const glm::vec3 &eye, const glm::vec3 &scale);
+
+        bool isActive() const
+        {
+            return poolTexture != 0;
+        }
+        GLuint getPoolTexture() const
+        {
+            return poolTexture;
+        }
+        GLuint getPageTableTexture() const
+        {
+            return pageTableTexture;
+        }
+        const glm::ivec3 &getGridSize() const
+        {
+            return gridSize;
+        }
+        glm::ivec3 getPoolSize() const
+        {
+            return poolSlots * slotSize;
+        }
+        int getBrickSize() const
+        {
+            return brickSize;
+        }
+
+        BrickPager(void);
+        ~BrickPager(void);
+};
@@ -0,0 +1,341 @@
+#include "BrickedVolume.h"
+#include "Parallel.h"
+#include "VolumePyramid.h"
+
+BrickedVolume::BrickedVolume(void)
+{
+    memset(&header, 0, sizeof(Header));
+    index = nullptr;
+}
+
+BrickedVolume::~BrickedVolume(void)
+{
+    close();
+}
+
+bool BrickedVolume::open(const char *pszFilepath)
+{
+    close();
+
+    if (!file.open(pszFilepath)) return false;
+
+    if (file.size() < sizeof(Header)) {
+        std::cout << "Error: " << pszFilepath << " is not a bricked volume" << std::endl;
+        close();
+        return false;
+    }
+
+    memcpy(&header, file.data(), sizeof(Header));
+
+    // levelSize shifts by the level, 30 levels already reach a single voxel
+    if (header.magic != MAGIC || header.version != VERSION || header.brickSize <= 0 ||
+            header.voxelType > VolumeData::Float32 || header.width <= 0 || header.height <= 0 || header.depth <= 0 ||
+            header.levelCount <= 0 || header.levelCount > 30) {
+        std::cout << "Error: " << pszFilepath << " unknown bricked volume format" << std::endl;
+        close();
+        return false;
+    }
+
+    size_t dataStart = sizeof(Header) + header.brickCount * sizeof(BrickInfo);
+
+    if (file.size() < dataStart + header.brickCount * brickBytes()) {
+        std::cout << "Error: " << pszFilepath << " bricked volume is truncated" << std::endl;
+        close();
+        return false;
+    }
+
+    // every level is bricked completely, one index entry per grid cell
+    unsigned long long gridBricks = 0;
+
+    for (int l = 0; l < header.levelCount; l++) {
+        glm::ivec3 grid = levelBricks(l);
+        gridBricks += (unsigned long long)grid.x * grid.y * grid.z;
+    }
+
+    if (gridBricks != header.brickCount) {
+        std::cout << "Error: " << pszFilepath << " brick count does not match its levels" << std::endl;
+        close();
+        return false;
+    }
+
+    const BrickInfo *entries = (const BrickInfo *)(file.data() + sizeof(Header));
+
+    for (unsigned int i = 0; i < header.brickCount; i++) {
+        const BrickInfo &brick = entries[i];
+        bool inGrid = brick.level >= 0 && brick.level < header.levelCount;
+
+        if (inGrid) {
+            glm::ivec3 grid = levelBricks(brick.level);
+            inGrid = brick.x >= 0 && brick.y >= 0 && brick.z >= 0 && brick.x < grid.x && brick.y < grid.y && brick.z < grid.z;
+        }
+
+        if (!inGrid || brick.offset < dataStart || brick.offset > file.size() || file.size() - brick.offset < brickBytes()) {
+            std::cout << "Error: " << pszFilepath << " brick " << i << " lies outside the volume or the file" << std::endl;
+            close();
+            return false;
+        }
+    }
+
+    index = entries;
+    return true;
+}
+
+void BrickedVolume::close()
+{
+    file.close();
+    index = nullptr;
+}
+
+static unsigned int spreadBits(unsigned int v)
+{
+    // 10 bits per axis, leaves two zero bits between every bit
+    v &= 0x3ff;
+    v = (v | (v << 16)) & 0x030000ff;
+    v = (v | (v << 8)) & 0x0300f00f;
+    v = (v | (v << 4)) & 0x030c30c3;
+    v = (v | (v << 2)) & 0x09249249;
+    return v;
+}
+
+unsigned int BrickedVolume::mortonCode(int x, int y, int z)
+{
+    return spreadBits(x) | (spreadBits(y) << 1) | (spreadBits(z) << 2);
+}
+
+glm::ivec3 BrickedVolume::levelSize(int level) const
+{
+    return VolumePyramid::levelSize(glm::ivec3(header.width, header.height, header.depth), level);
+}
+
+glm::ivec3 BrickedVolume::levelBricks(int level) const
+{
+    int bs = header.brickSize;
+    return (levelSize(level) + glm::ivec3(bs - 1)) / bs;
+}
+
+std::vector<const BrickedVolume::BrickInfo *> BrickedVolume::bricksInRegion(int level, const glm::ivec3 &minVoxel,
+        const glm::ivec3 &maxVoxel) const
+{
+    std::vector<const BrickInfo *> result;
+    int bs = header.brickSize;
+    glm::ivec3 first = minVoxel / bs;
+    glm::ivec3 last = (maxVoxel - glm::ivec3(1)) / bs;
+
+    for (unsigned int i = 0; i < header.brickCount; i++) {
+        const BrickInfo &brick = index[i];
+
+        if (brick.level == level &&
+                brick.x >= first.x && brick.x <= last.x &&
+                brick.y >= first.y && brick.y <= last.y &&
+                brick.z >= first.z && brick.z <= last.z) {
+            result.push_back(&brick);
+        }
+    }
+
+    return result;
+}
+
+bool BrickedVolume::readRegion(int level, const glm::ivec3 &minVoxel, const glm::ivec3 &maxVoxel, VolumeData &dst) const
+{
+    if (!isOpen() || level < 0 || level >= header.levelCount) return false;
+
+    glm::ivec3 lo = glm::max(minVoxel, glm::ivec3(0));
+    glm::ivec3 hi = glm::min(maxVoxel, levelSize(level));
+    glm::ivec3 extent = hi - lo;
+
+    if (extent.x <= 0 || extent.y <= 0 || extent.z <= 0) return false;
+
+    VolumeData::VoxelType type = (VolumeData::VoxelType)header.voxelType;
+    size_t voxelBytes = VolumeData::bytesPerVoxel(type);
+    int bs = header.brickSize;
+    dst.allocate(type, extent.x, extent.y, extent.z);
+    unsigned char *out = (unsigned char *)dst.mutableData();
+    std::vector<const BrickInfo *> bricks = bricksInRegion(level, lo, hi);
+    // bricks cover disjoint parts of the region
+    parallelFor(0, (int)bricks.size(), [&](int first, int last) {
+        for (int b = first; b < last; b++) {
+            const BrickInfo &brick = *bricks[b];
+            const unsigned char *src = (const unsigned char *)brickData(brick);
+            glm::ivec3 origin = glm::ivec3(brick.x, brick.y, brick.z) * bs;
+            glm::ivec3 from = glm::max(lo, origin);
+            glm::ivec3 to = glm::min(hi, origin + glm::ivec3(bs));
+            size_t rowBytes = (to.x - from.x) * voxelBytes;
+
+            for (int z = from.z; z < to.z; z++) {
+                for (int y = from.y; y < to.y; y++) {
+                    size_t srcIndex = (from.x - origin.x) + (y - origin.y) * bs + (size_t)(z - origin.z) * bs * bs;
+                    size_t dstIndex = (from.x - lo.x) + (y - lo.y) * extent.x + (size_t)(z - lo.z) * extent.x * extent.y;
+                    memcpy(out + dstIndex * voxelBytes, src + srcIndex * voxelBytes, rowBytes);
+                }
+            }
+        }
+    });
+    return true;
+}
+
+bool BrickedVolume::readLevel(int level, VolumeData &dst) const
+{
+    return readRegion(level, glm::ivec3(0), levelSize(level), dst);
+}
+
+// copies the brick voxels, padding partial bricks with the border voxels,
+// and gathers the statistics of the voxels that are really inside the volume
+template<typename T>
+static void bakeBrick(const VolumeData &level, BrickedVolume::BrickInfo &brick, int bs, T *dst)
+{
+    VoxelAccessor<T> voxels(level);
+    int w = level.width(), h = level.height(), d = level.depth();
+    glm::ivec3 origin = glm::ivec3(brick.x, brick.y, brick.z) * bs;
+    float min = std::numeric_limits<float>::max(), max = -min;
+    double sum = 0.0;
+    size_t count = 0;
+
+    for (int z = 0; z < bs; z++) {
+        for (int y = 0; y < bs; y++) {
+            for (int x = 0; x < bs; x++) {
+                int vx = origin.x + x, vy = origin.y + y, vz = origin.z + z;
+                size_t src = std::min(vx, w - 1) + std::min(vy, h - 1) * w + (size_t)std::min(vz, d - 1) * w * h;
+                *dst++ = voxels.raw(src);
+
+                if (vx < w && vy < h && vz < d) {
+                    float value = voxels[src];
+                    min = std::min(min, value);
+                    max = std::max(max, value);
+                    sum += value;
+                    count++;
+                }
+            }
+        }
+    }
+
+    brick.min = min;
+    brick.max = max;
+    brick.mean = (float)(sum / count);
+}
+
+template<typename T>
+static void bakeBricks(const VolumeData &level, BrickedVolume::BrickInfo *bricks, int count, int bs, unsigned char *dst)
+{
+    size_t brickVoxels = (size_t)bs * bs * bs;
+    parallelFor(0, count, [&](int first, int last) {
+        for (int i = first; i < last; i++) {
+            bakeBrick(level, bricks[i], bs, (T *)dst + i * brickVoxels);
+        }
+    });
+}
+
+bool BrickedVolume::convert(const VolumeData &source, const char *pszFilepath, int brickSize, int levels)
+{
+    if (source.empty() || brickSize <= 0) return false;
+
+    // automatic level count stops once the volume fits in a single brick
+    if (levels <= 0) {
+        levels = VolumePyramid::levelCountFor(glm::ivec3(source.width(), source.height(), source.depth()), brickSize);
+    }
+
+    // resolution levels, 0 is the source itself
+    VolumePyramid pyramid;
+    pyramid.setBase(source);
+
+    for (int l = 1; l < levels; l++) {
+        std::unique_ptr<VolumeData> next(new VolumeData());
+        VolumePyramid::downsample(pyramid.level(l - 1), *next);
+        pyramid.addLevel(std::move(next));
+    }
+
+    Header header = {};
+    header.magic = MAGIC;
+    header.version = VERSION;
+    header.voxelType = source.type();
+    header.width = source.width();
+    header.height = source.height();
+    header.depth = source.depth();
+    header.brickSize = brickSize;
+    header.levelCount = levels;
+    // brick index, level by level in morton order
+    std::vector<BrickInfo> bricks;
+
+    for (int l = 0; l < levels; l++) {
+        const VolumeData &level = pyramid.level(l);
+        glm::ivec3 grid = (glm::ivec3(level.width(), level.height(), level.depth()) + glm::ivec3(brickSize - 1)) / brickSize;
+        size_t levelStart = bricks.size();
+
+        for (int z = 0; z < grid.z; z++) {
+            for (int y = 0; y < grid.y; y++) {
+                for (int x = 0; x < grid.x; x++) {
+                    BrickInfo brick = {};
+                    brick.level = l;
+                    brick.x = x;
+                    brick.y = y;
+                    brick.z = z;
+                    bricks.push_back(brick);
+                }
+            }
+        }
+
+        std::sort(bricks.begin() + levelStart, bricks.end(), [](const BrickInfo & a, const BrickInfo & b) {
+            return mortonCode(a.x, a.y, a.z) < mortonCode(b.x, b.y, b.z);
+        });
+    }
+
+    header.brickCount = (unsigned int)bricks.size();
+    size_t bytes = (size_t)brickSize * brickSize * brickSize * source.bytesPerVoxel();
+    unsigned long long dataStart = sizeof(Header) + bricks.size() * sizeof(BrickInfo);
+
+    for (size_t i = 0; i < bricks.size(); i++) {
+        bricks[i].offset = dataStart + i * bytes;
+    }
+
+    std::ofstream out(pszFilepath, std::ios::binary | std::ios::trunc);
+
+    if (!out.is_open()) {
+        std::cout << "Error: opening " << pszFilepath << " for writing failed" << std::endl;
+        return false;
+    }
+
+    // bricks are baked in batches so memory stays bounded for large volumes
+    int batchSize = std::max(1, MainData::AVAILABLE_CORES) * 8;
+    std::vector<unsigned char> batch(batchSize * bytes);
+    size_t first = 0;
+    out.seekp(dataStart);
+
+    while (first < bricks.size()) {
+        // a batch never mixes levels so one level volume feeds it
+        size_t last = std::min(bricks.size(), first + batchSize);
+        int level = bricks[first].level;
+
+        while (bricks[last - 1].level != level) last--;
+
+        BrickInfo *infos = &bricks[first];
+        int count = (int)(last - first);
+
+        switch (source.type()) {
+            case VolumeData::UInt16:
+                bakeBricks<unsigned short>(pyramid.level(level), infos, count, brickSize, &batch[0]);
+                break;
+
+            case VolumeData::Float32:
+                bakeBricks<float>(pyramid.level(level), infos, count, brickSize, &batch[0]);
+                break;
+
+            default:
+                bakeBricks<unsigned char>(pyramid.level(level), infos, count, brickSize, &batch[0]);
+                break;
+        }
+
+        out.write((const char *)&batch[0], count * bytes);
+        first = last;
+    }
+
+    out.seekp(0);
+    out.write((const char *)&header, sizeof(Header));
+    out.write((const char *)&bricks[0], bricks.size() * sizeof(BrickInfo));
+
+    if (!out.good()) {
+        std::cout << "Error: writing " << pszFilepath << " failed" << std::endl;
+        return false;
+    }
+
+    std::cout << "OK: bricked volume " << pszFilepath << " written, " << bricks.size() << " bricks in " << levels << " levels" << std::endl;
+    return true;
+}
@@ -0,0 +1,94 @@
+#pragma once
+#include "Commons.h"
+#include "MappedFile.h"
+#include "VolumeData.h"
+
+// bricked volume container (.bvol), every resolution level is split in
+// cubic bricks stored in morton order after a header and a brick index
+// holding the normalized min, max and mean of each brick
+//
+// | Header | BrickInfo * brickCount | brick voxels ... |
+class BrickedVolume {
+    public:
+        static const unsigned int MAGIC = 0x4c4f5642; // "BVOL"
+        static const unsigned int VERSION = 1;
+        static const int DEFAULT_BRICK_SIZE = 32;
+
+        struct Header {
+            unsigned int magic;
+            unsigned int version;
+            unsigned int voxelType;
+            int width;
+            int height;
+            int depth;
+            int brickSize;
+            int levelCount;
+            unsigned int brickCount;
+            unsigned int reserved;
+        };
+
+        struct BrickInfo {
+            int level;
+            // brick coordinates in the level brick grid
+            int x, y, z;
+            float min;
+            float max;
+            float mean;
+            unsigned int reserved;
+            // from the start of the file
+            unsigned long long offset;
+        };
+
+    private:
+        MappedFile file;
+        Header header;
+        const BrickInfo *index;
+
+    public:
+        bool open(const char *pszFilepath);
+        void close();
+        // bricks the source in brickSize^3 blocks, levels > 1 also store
+        // 2x downsampled versions of the volume, 0 picks them automatically
+        static bool convert(const VolumeData &source, const char *pszFilepath, int brickSize = DEFAULT_BRICK_SIZE, int levels = 0);
+        static unsigned int mortonCode(int x, int y, int z);
+
+        glm::ivec3 levelSize(int level) const;
+        glm::ivec3 levelBricks(int level) const;
+        // index entries of the bricks overlapping [minVoxel, maxVoxel) on the given level
+        std::vector<const BrickInfo *> bricksInRegion(int level, const glm::ivec3 &minVoxel, const glm::ivec3 &maxVoxel) const;
+        // true if no voxel of the brick falls on the normalized range [low, high]
+        static bool isBrickOutside(const BrickInfo &brick, float low, float high)
+        {
+            return brick.max < low || brick.min > high;
+        }
+        // zero copy pointer to the brick voxels inside the mapped file
+        const void *brickData(const BrickInfo &brick) const
+        {
+            return file.data() + brick.offset;
+        }
+        // assembles only the bricks overlapping the region into dst
+        bool readRegion(int level, const glm::ivec3 &minVoxel, const glm::ivec3 &maxVoxel, VolumeData &dst) const;
+        bool readLevel(int level, VolumeData &dst) const;
+
+        const Header &getHeader() const
+        {
+            return header;
+        }
+        const BrickInfo *getIndex() const
+        {
+            return index;
+        }
+        size_t brickBytes() const
+        {
+            return (size_t)header.brickSize * header.brickSize * header.brickSize *
+                   VolumeData::bytesPerVoxel((VolumeData::VoxelType)header.voxelType);
+        }
+        bool isOpen() const
+        {
+            return index != nullptr;
+        }
+
+        BrickedVolume(void);
+        ~BrickedVolume(void);
+};
+
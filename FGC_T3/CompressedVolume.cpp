@@ -0,0 +1,262 @@
+#include "CompressedVolume.h"
+#include "Parallel.h"
+
+// repeated values shorter than this are cheaper stored as literals
+static const size_t MIN_RUN = 3;
+
+CompressedVolume::CompressedVolume(void)
+{
+    voxelType = VolumeData::UInt8;
+    size = bricks = glm::ivec3(0);
+    brickSize = DEFAULT_BRICK_SIZE;
+    decoded.setCapacity(DEFAULT_CACHE_BYTES);
+}
+
+CompressedVolume::~CompressedVolume(void)
+{
+}
+
+static void writeVarint(std::vector<unsigned char> &out, size_t value)
+{
+    while (value >= 0x80) {
+        out.push_back((unsigned char)(value | 0x80));
+        value >>= 7;
+    }
+
+    out.push_back((unsigned char)value);
+}
+
+static size_t readVarint(const unsigned char *&in)
+{
+    size_t value = 0;
+
+    for (int shift = 0; ; shift += 7) {
+        unsigned char byte = *in++;
+        value |= (size_t)(byte & 0x7f) << shift;
+
+        if (!(byte & 0x80)) return value;
+    }
+}
+
+// tokens are a varint length, odd for a run of one value and even for
+// that many literal values following it
+template<typename U>
+static void encodeRuns(const U *values, size_t count, std::vector<unsigned char> &out)
+{
+    size_t i = 0;
+
+    while (i < count) {
+        size_t run = 1;
+
+        while (i + run < count && values[i + run] == values[i]) run++;
+
+        if (run >= MIN_RUN) {
+            writeVarint(out, run << 1 | 1);
+            out.insert(out.end(), (const unsigned char *)&values[i], (const unsigned char *)&values[i + 1]);
+            i += run;
+        } else {
+            size_t end = i + run;
+
+            // literals end where the next run starts
+            while (end < count && !(end + MIN_RUN <= count && values[end] == values[end + 1] && values[end] == values[end + 2])) end++;
+
+            writeVarint(out, (end - i) << 1);
+            out.insert(out.end(), (const unsigned char *)&values[i], (const unsigned char *)&values[end]);
+            i = end;
+        }
+    }
+}
+
+template<typename U>
+static void decodeRuns(const unsigned char *in, size_t count, U *values)
+{
+    size_t i = 0;
+
+    while (i < count) {
+        size_t token = readVarint(in);
+        size_t length = token >> 1;
+
+        if (token & 1) {
+            U value;
+            memcpy(&value, in, sizeof(U));
+            in += sizeof(U);
+            std::fill(values + i, values + i + length, value);
+        } else {
+            memcpy(values + i, in, length * sizeof(U));
+            in += length * sizeof(U);
+        }
+
+        i += length;
+    }
+}
+
+// deltas wrap around in the unsigned type, floats are coded by their bits
+template<typename U>
+static void encodeBrick(const VolumeData &source, const glm::ivec3 &origin, const glm::ivec3 &extent, std::vector<unsigned char> &out)
+{
+    const U *voxels = source.as<U>();
+    std::vector<U> deltas((size_t)extent.x * extent.y * extent.z);
+    size_t sliceSize = (size_t)source.width() * source.height();
+    U previous = 0;
+    size_t i = 0;
+
+    for (int z = 0; z < extent.z; z++) {
+        for (int y = 0; y < extent.y; y++) {
+            const U *row = voxels + origin.x + (origin.y + y) * (size_t)source.width() + (origin.z + z) * sliceSize;
+
+            for (int x = 0; x < extent.x; x++) {
+                deltas[i++] = (U)(row[x] - previous);
+                previous = row[x];
+            }
+        }
+    }
+
+    encodeRuns(&deltas[0], deltas.size(), out);
+}
+
+template<typename U>
+static void decodeBrick(const unsigned char *in, size_t count, U *dst)
+{
+    decodeRuns(in, count, dst);
+
+    for (size_t i = 1; i < count; i++) dst[i] = (U)(dst[i] + dst[i - 1]);
+}
+
+void CompressedVolume::compress(const VolumeData &source, int brickSize)
+{
+    clear();
+    voxelType = source.type();
+    size = glm::ivec3(source.width(), source.height(), source.depth());
+    this->brickSize = brickSize;
+    bricks = (size + brickSize - 1) / brickSize;
+    int brickCount = bricks.x * bricks.y * bricks.z;
+    std::vector<std::vector<unsigned char>> encoded(brickCount);
+    parallelFor(0, brickCount, [&](int first, int last) {
+        for (int b = first; b < last; b++) {
+            glm::ivec3 brick(b % bricks.x, (b / bricks.x) % bricks.y, b / (bricks.x * bricks.y));
+            glm::ivec3 origin = brick * brickSize;
+
+            switch (voxelType) {
+                case VolumeData::UInt16:
+                    encodeBrick<unsigned short>(source, origin, brickExtent(brick), encoded[b]);
+                    break;
+
+                case VolumeData::Float32:
+                    encodeBrick<unsigned int>(source, origin, brickExtent(brick), encoded[b]);
+                    break;
+
+                default:
+                    encodeBrick<unsigned char>(source, origin, brickExtent(brick), encoded[b]);
+                    break;
+            }
+        }
+    });
+    offsets.resize(brickCount + 1, 0);
+
+    for (int b = 0; b < brickCount; b++) offsets[b + 1] = offsets[b] + encoded[b].size();
+
+    stream.resize(offsets.back());
+
+    for (int b = 0; b < brickCount; b++) {
+        if (!encoded[b].empty()) memcpy(&stream[offsets[b]], &encoded[b][0], encoded[b].size());
+    }
+
+    std::cout << "OK: cpu copy compressed from " << (source.sizeInBytes() >> 20) << " to " << (sizeInBytes() >> 20) << " MB" << std::endl;
+}
+
+void CompressedVolume::clear()
+{
+    std::vector<unsigned char>().swap(stream);
+    std::vector<size_t>().swap(offsets);
+    decoded.clear();
+    size = bricks = glm::ivec3(0);
+}
+
+glm::ivec3 CompressedVolume::brickExtent(const glm::ivec3 &brick) const
+{
+    return glm::min(glm::ivec3(brickSize), size - brick * brickSize);
+}
+
+void CompressedVolume::decodeBrick(int brick, unsigned char *dst) const
+{
+    glm::ivec3 extent = brickExtent(glm::ivec3(brick % bricks.x, (brick / bricks.x) % bricks.y, brick / (bricks.x * bricks.y)));
+    size_t count = (size_t)extent.x * extent.y * extent.z;
+    const unsigned char *in = stream.empty() ? nullptr : &stream[offsets[brick]];
+
+    switch (voxelType) {
+        case VolumeData::UInt16:
+            ::decodeBrick(in, count, (unsigned short *)dst);
+            break;
+
+        case VolumeData::Float32:
+            ::decodeBrick(in, count, (unsigned int *)dst);
+            break;
+
+        default:
+            ::decodeBrick(in, count, dst);
+            break;
+    }
+}
+
+BrickCache::Data CompressedVolume::fetchBrick(int brick) const
+{
+    BrickCache::Data data = decoded.get(brick);
+
+    if (data) return data;
+
+    glm::ivec3 extent = brickExtent(glm::ivec3(brick % bricks.x, (brick / bricks.x) % bricks.y, brick / (bricks.x * bricks.y)));
+    std::shared_ptr<std::vector<unsigned char>> voxels(new std::vector<unsigned char>((size_t)extent.x * extent.y * extent.z *
+            VolumeData::bytesPerVoxel(voxelType)));
+    decodeBrick(brick, &(*voxels)[0]);
+    decoded.put(brick, voxels);
+    return voxels;
+}
+
+float CompressedVolume::sample(int x, int y, int z) const
+{
+    glm::ivec3 voxel = glm::clamp(glm::ivec3(x, y, z), glm::ivec3(0), size - 1);
+    glm::ivec3 brick = voxel / brickSize;
+    glm::ivec3 local = voxel - brick * brickSize;
+    glm::ivec3 extent = brickExtent(brick);
+    BrickCache::Data data = fetchBrick(brick.x + brick.y * bricks.x + brick.z * bricks.x * bricks.y);
+    size_t index = local.x + local.y * (size_t)extent.x + local.z * (size_t)extent.x * extent.y;
+
+    switch (voxelType) {
+        case VolumeData::UInt16:
+            return ((const unsigned short *)&(*data)[0])[index] * (1.f / 65535);
+
+        case VolumeData::Float32:
+            return ((const float *)&(*data)[0])[index];
+
+        default:
+            return (*data)[index] * (1.f / 255);
+    }
+}
+
+void CompressedVolume::decompress(VolumeData &dst) const
+{
+    dst.allocate(voxelType, size.x, size.y, size.z);
+    size_t bytesPerVoxel = dst.bytesPerVoxel();
+    size_t rowBytes = size.x * bytesPerVoxel;
+    size_t sliceBytes = rowBytes * size.y;
+    unsigned char *voxels = (unsigned char *)dst.mutableData();
+    int brickCount = bricks.x * bricks.y * bricks.z;
+    // whole volume decodes bypass the cache, every brick is read once
+    parallelFor(0, brickCount, [&](int first, int last) {
+        std::vector<unsigned char> brickVoxels((size_t)brickSize * brickSize * brickSize * bytesPerVoxel);
+
+        for (int b = first; b < last; b++) {
+            glm::ivec3 brick(b % bricks.x, (b / bricks.x) % bricks.y, b / (bricks.x * bricks.y));
+            glm::ivec3 origin = brick * brickSize;
+            glm::ivec3 extent = brickExtent(brick);
+            decodeBrick(b, &brickVoxels[0]);
+
+            for (int z = 0; z < extent.z; z++) {
+                for (int y = 0; y < extent.y; y++) {
+                    memcpy(voxels + origin.x * bytesPerVoxel + (origin.y + y) * rowBytes + (origin.z + z) * sliceBytes,
+                           &brickVoxels[(y + z * (size_t)extent.y) * extent.x * bytesPerVoxel], extent.x * bytesPerVoxel);
+                }
+            }
+        }
+    });
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include "Commons.h"
+#include "VolumeData.h"
+#include "BrickCache.h"
+
+// lossless cpu copy of a volume split in independently compressed bricks.
+// each brick stores the difference of every voxel with the previous one,
+// run length encoded, so empty space and smooth regions shrink to a few
+// bytes. random reads decode whole bricks into a small lru cache
+class CompressedVolume {
+    private:
+        VolumeData::VoxelType voxelType;
+        glm::ivec3 size;
+        glm::ivec3 bricks;
+        int brickSize;
+        // encoded bricks back to back, brick i is [offsets[i], offsets[i + 1])
+        std::vector<unsigned char> stream;
+        std::vector<size_t> offsets;
+        mutable BrickCache decoded;
+
+        glm::ivec3 brickExtent(const glm::ivec3 &brick) const;
+        void decodeBrick(int brick, unsigned char *dst) const;
+        BrickCache::Data fetchBrick(int brick) const;
+
+        CompressedVolume(const CompressedVolume &);
+        CompressedVolume &operator=(const CompressedVolume &);
+    public:
+        static const int DEFAULT_BRICK_SIZE = 16;
+        static const size_t DEFAULT_CACHE_BYTES = 16 << 20;
+
+        void compress(const VolumeData &source, int brickSize = DEFAULT_BRICK_SIZE);
+        void decompress(VolumeData &dst) const;
+        void clear();
+        // normalized value like VoxelAccessor, clamps to the volume borders
+        float sample(int x, int y, int z) const;
+
+        bool empty() const
+        {
+            return offsets.empty();
+        }
+        VolumeData::VoxelType type() const
+        {
+            return voxelType;
+        }
+        const glm::ivec3 &getSize() const
+        {
+            return size;
+        }
+        size_t sizeInBytes() const
+        {
+            return stream.size() + offsets.size() * sizeof(size_t);
+        }
+
+        CompressedVolume(void);
+        ~CompressedVolume(void);
+};
+
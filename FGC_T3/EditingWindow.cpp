@@ -5,7 +5,10 @@ EditingWindow::EditingWindow(void)
     histogram.fill(0);
     dragStarted = false;
     isHistLoaded = false;
+    jointChanged = false;
     mouseOverIndex = -1;
+    viewLow = 0;
+    viewHigh = 1;
     rawModel = NULL;
     windowThread = NULL;
     parent = window = NULL;
@@ -45,6 +48,8 @@ void EditingWindow::windowRender(EditingWindow *eWin)
             while (eWin->window->pollEvent(event)) {
                 if (event.type == sf::Event::MouseButtonPressed && sf::Mouse::isButtonPressed(sf::Mouse::Middle)) {
                     eWin->updateTransferFunction();
+                } else if (event.type == sf::Event::MouseWheelMoved) {
+                    eWin->zoom(event.mouseWheel.x, event.mouseWheel.delta, eWin->rawModel->transferFunction.snapshot()->maxIsoValue);
                 }
             }
 
@@ -61,20 +66,34 @@ void EditingWindow::windowRender(EditingWindow *eWin)
 void EditingWindow::loadHistogram()
 {
     isHistLoaded = false;
-    this->histogram.fill(0);
-    int max = 0;
-
-    for (int i = 0; i < rawModel->width * rawModel->height * rawModel->numCuts; i++) {
-        unsigned int index = (int)(rawModel->dataScalars[i] * 255.f);
-        histogram[index] = histogram[index] + 1;
-        max < histogram[index] ? max = histogram[index] : 0;
-    }
+    // counted by the loader, or read back from the volume cache
+    const std::array<unsigned int, 256> &counts = rawModel->getHistogram();
+    float max = (float)std::max(1u, *std::max_element(counts.begin(), counts.end()));
 
     for (int i = 0; i < 256;  i++) {
-        histogram[i] /= max;
+        histogram[i] = counts[i] / max;
         histogram[i] = std::log(histogram[i] + 1) * (1.f / log(2)); // scale
     }
 
+    const JointHistogram &joint = rawModel->getJointHistogram();
+
+    if (!joint.empty()) {
+        std::lock_guard<std::mutex> lock(jointMutex);
+        float jointMax = (float)std::max(1u, *std::max_element(joint.data(), joint.data() + JointHistogram::VALUE_BINS *
+                                         JointHistogram::GRADIENT_BINS));
+        jointImage.create(JointHistogram::VALUE_BINS, JointHistogram::GRADIENT_BINS, sf::Color::Transparent);
+
+        for (int g = 0; g < JointHistogram::GRADIENT_BINS; g++) {
+            for (int v = 0; v < JointHistogram::VALUE_BINS; v++) {
+                float density = std::log(joint.at(v, g) / jointMax + 1) * (1.f / log(2)); // scale
+                // strong gradients on top, like the opacity axis
+                jointImage.setPixel(v, JointHistogram::GRADIENT_BINS - 1 - g, sf::Color(60, 140, 255, (sf::Uint8)(density * 160.f)));
+            }
+        }
+
+        jointChanged = true;
+    }
+
     isHistLoaded = true;
 }
 
@@ -93,12 +112,42 @@ bool EditingWindow::isMouseOver()
     }
 }
 
+int EditingWindow::toIsoValue(int x, int maxIsoValue) const
+{
+    // inverse of toPlotX, every pixel maps to its own iso value
+    float fraction = viewLow + (x + 3) / 765.f * (viewHigh - viewLow);
+    return std::min(std::max((int)(fraction * maxIsoValue + 0.5f), 0), maxIsoValue);
+}
+
+float EditingWindow::toPlotX(int isoValue, int maxIsoValue) const
+{
+    return toPlotX((float)isoValue / maxIsoValue);
+}
+
+float EditingWindow::toPlotX(float fraction) const
+{
+    return (fraction - viewLow) / (viewHigh - viewLow) * 765.f - 3;
+}
+
+void EditingWindow::zoom(int x, int delta, int maxIsoValue)
+{
+    float span = viewHigh - viewLow;
+    float anchor = std::min(std::max((x + 3) / 765.f, 0.f), 1.f);
+    float focus = viewLow + anchor * span;
+    // no closer than 3 pixels per iso value, 8 bit data already fits
+    float minSpan = std::min(1.f, 255.f / maxIsoValue);
+    span = std::min(std::max(span * std::pow(0.8f, (float)delta), minSpan), 1.f);
+    viewLow = std::min(std::max(focus - anchor * span, 0.f), 1.f - span);
+    viewHigh = viewLow + span;
+}
+
 void EditingWindow::updateTransferFunction()
 {
     if (sf::Mouse::getPosition(*this->window).y > 2 && sf::Mouse::getPosition(*this->window).x > 0 &&
             sf::Mouse::getPosition(*this->window).x < 769 && sf::Mouse::getPosition(*this->window).y < 259) {
-        TransferFunction::addControlPoint(255, 255, 255, 255 - sf::Mouse::getPosition(*this->window).y + 3,
-                                          sf::Mouse::getPosition(*this->window).x / 3);
+        int maxIsoValue = this->rawModel->transferFunction.snapshot()->maxIsoValue;
+        this->rawModel->transferFunction.addControlPoint(255, 255, 255, 255 - sf::Mouse::getPosition(*this->window).y + 3,
+                toIsoValue(sf::Mouse::getPosition(*this->window).x, maxIsoValue));
         this->controlPointChanged = true;
     }
 }
@@ -119,21 +168,39 @@ void EditingWindow::drawHistogram()
 {
     if (!this->isHistLoaded) return;
 
-    for (int i = 0; i < 256; i++) {
+    // cleared before the upload, an image set meanwhile is loaded next frame
+    if (this->jointChanged.exchange(false)) {
+        std::lock_guard<std::mutex> lock(this->jointMutex);
+        this->jointTexture.loadFromImage(this->jointImage);
+        this->jointSprite.setTexture(this->jointTexture, true);
+    }
+
+    // bins of a 256th of the range, stretched over the visible part
+    float binWidth = 3.f / (viewHigh - viewLow);
+    int firstBin = (int)std::floor(viewLow * 256);
+    int lastBin = std::min((int)std::ceil(viewHigh * 256), 256);
+    this->jointSprite.setTextureRect(sf::IntRect(firstBin * JointHistogram::VALUE_BINS / 256, 0,
+                                     (lastBin - firstBin) * JointHistogram::VALUE_BINS / 256, JointHistogram::GRADIENT_BINS));
+    this->jointSprite.setScale(binWidth * 256 / JointHistogram::VALUE_BINS, 1);
+    this->jointSprite.setPosition(5 + (firstBin / 256.f - viewLow) * 256 * binWidth, 4);
+    this->window->draw(this->jointSprite);
+
+    for (int i = firstBin; i < lastBin; i++) {
+        float x = 5 + (i / 256.f - viewLow) * 256 * binWidth;
         // Histogram Values
         this->line.setSize(sf::Vector2f(this->histogram[i] * 256.0f, 2));
-        this->line.setPosition(5 + i * 3, 260);
+        this->line.setPosition(x, 260);
         this->window->draw(this->line);
         /// Transfer Function Result
         glm::vec4 color = this->rawModel->transferFunc[i];
-        this->indicator.setSize(sf::Vector2f(3, 10));
-        this->indicator.setPosition(5 + i * 3, 273);
+        this->indicator.setSize(sf::Vector2f(binWidth, 10));
+        this->indicator.setPosition(x, 273);
         // this->indicator.setFillColor(sf::Color((int)(color.r * 255.f), (int)(color.g * 255.f), (int)(color.b * 255.f), (int)(color.a * 255.f)));
         this->indicator.setFillColor(sf::Color((int)(color.a * 255.f), (int)(color.a * 255.f), (int)(color.a * 255.f), (int)(color.a * 255.f)));
         this->window->draw(this->indicator);
         // Iso Value Indicators
         this->indicator.setSize(sf::Vector2f(2, 10));
-        this->indicator.setPosition(5 + i * 3, 260);
+        this->indicator.setPosition(x, 260);
         this->indicator.setFillColor(sf::Color(i, i, i, i));
         this->window->draw(this->indicator);
     }
@@ -142,15 +209,16 @@ void EditingWindow::drawHistogram()
 void EditingWindow::drawControlPointCircles(int i)
 {
     // Circles for Controls Points
+    const std::vector<ControlPoint> &controlPoints = this->snapshot->controlPoints;
     sf::Color rgba;
-    rgba.r = TransferFunction::getControlPoints()[i].rgba[0] * 255;
-    rgba.g = TransferFunction::getControlPoints()[i].rgba[1] * 255;
-    rgba.b = TransferFunction::getControlPoints()[i].rgba[2] * 255;
-    rgba.a = TransferFunction::getControlPoints()[i].rgba[3] * 255;
+    rgba.r = controlPoints[i].rgba[0] * 255;
+    rgba.g = controlPoints[i].rgba[1] * 255;
+    rgba.b = controlPoints[i].rgba[2] * 255;
+    rgba.a = controlPoints[i].rgba[3] * 255;
     this->circle.setOutlineThickness(1);
     this->circle.setFillColor(rgba);
     this->circle.setOutlineColor(sf::Color::Cyan);
-    this->circle.setPosition(TransferFunction::getControlPoints()[i].isoValue * 3 - 3, 255 - TransferFunction::getControlPoints()[i].rgba[3] * 255);
+    this->circle.setPosition(toPlotX(controlPoints[i].isoValue, this->snapshot->maxIsoValue), 255 - controlPoints[i].rgba[3] * 255);
 
     if (isMouseOver()) {
         this->circle.setOutlineColor(sf::Color::Green);
@@ -166,15 +234,14 @@ void EditingWindow::drawControlPointCircles(int i)
                 this->dragStarted = true;
             } else {
                 this->circle.setOutlineThickness(2);
-                int finalIsoValue = sf::Mouse::getPosition(*this->window).x / 3;
+                int finalIsoValue = toIsoValue(sf::Mouse::getPosition(*this->window).x, this->snapshot->maxIsoValue);
                 int finalAlphaValue = 255 - sf::Mouse::getPosition(*this->window).y + 3;
-                TransferFunction::deleteAlphaControlPoint(i);
-                finalIsoValue = i == 0 ? 0 : i == TransferFunction::getControlPoints().size() ? 255 : finalIsoValue;
-                TransferFunction::addControlPoint(rgba.r, rgba.g, rgba.b, finalAlphaValue, finalIsoValue);
+                finalIsoValue = i == 0 ? 0 : i == controlPoints.size() - 1 ? this->snapshot->maxIsoValue : finalIsoValue;
+                this->rawModel->transferFunction.moveControlPoint(i, finalAlphaValue, finalIsoValue);
             }
         } else if (sf::Mouse::isButtonPressed(sf::Mouse::Right) && i == this->mouseOverIndex) {
-            if (i > 0 && i < TransferFunction::getControlPoints().size() - 1) {
-                TransferFunction::deleteAlphaControlPoint(i);
+            if (i > 0 && i < controlPoints.size() - 1) {
+                this->rawModel->transferFunction.deleteControlPoint(i);
             }
         } else {
             this->mouseOverIndex = -1;
@@ -187,11 +254,13 @@ void EditingWindow::drawControlPointCircles(int i)
 
 void EditingWindow::drawTransferFuncPlot(int i)
 {
+    const std::vector<ControlPoint> &controlPoints = this->snapshot->controlPoints;
+
     // Plotting lines
-    if (i < TransferFunction::getControlPoints().size() - 1) {
+    if (i < controlPoints.size() - 1) {
         sf::RectangleShape plotLine;
-        sf::Vector2f nextPos = sf::Vector2f(TransferFunction::getControlPoints().at(i + 1).isoValue * 3 - 3 + 4,
-                                            255 - TransferFunction::getControlPoints().at(i + 1).rgba[3] * 255 + 4);
+        sf::Vector2f nextPos = sf::Vector2f(toPlotX(controlPoints.at(i + 1).isoValue, this->snapshot->maxIsoValue) + 4,
+                                            255 - controlPoints.at(i + 1).rgba[3] * 255 + 4);
         sf::Vector2f currentPos = sf::Vector2f(this->circle.getPosition().x + 4, this->circle.getPosition().y + 4);
         float xDiff = currentPos.x - nextPos.x;
         float yDiff = currentPos.y - nextPos.y;
@@ -207,14 +276,21 @@ void EditingWindow::drawTransferFuncPlot(int i)
 void EditingWindow::drawHistogramAndTransferFunc()
 {
     drawHistogram();
+    // edits made while drawing show up next frame, the render thread bakes
+    // them into its textures on its own
+    std::shared_ptr<const TransferFunction::Snapshot> previous = this->snapshot;
+    this->snapshot = this->rawModel->transferFunction.snapshot();
 
-    for (int i = 0; i < TransferFunction::getControlPoints().size(); i++) {
+    // a volume with another range starts unzoomed
+    if (previous && previous->maxIsoValue != this->snapshot->maxIsoValue) {
+        viewLow = 0;
+        viewHigh = 1;
+    }
+
+    for (int i = 0; i < this->snapshot->controlPoints.size(); i++) {
         drawControlPointCircles(i);
         drawTransferFuncPlot(i);
     }
-
-    // Update Transfer Function Real-Time
-    this->rawModel->updateTransferFunctionTexture();
 }
 
 bool EditingWindow::frameDone = false;
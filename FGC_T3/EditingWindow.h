@@ -12,10 +12,27 @@ class EditingWindow {
         sf::RectangleShape indicator;
         RawDataModel *rawModel;
         std::array<float, 256> histogram;
+        // value by gradient magnitude counts behind the 1d histogram, built
+        // on load and turned into a texture on the window thread
+        sf::Image jointImage;
+        sf::Texture jointTexture;
+        sf::Sprite jointSprite;
+        std::mutex jointMutex;
+        std::atomic<bool> jointChanged;
+        // control points drawn this frame
+        std::shared_ptr<const TransferFunction::Snapshot> snapshot;
         bool isHistLoaded;
         bool dragStarted;
         int mouseOverIndex;
+        // visible part of the value axis as fractions of the full range, the
+        // mouse wheel zooms around the cursor so 12 and 16 bit features fit
+        float viewLow, viewHigh;
 
+        // iso values in native units on the 768 pixels wide plot
+        int toIsoValue(int x, int maxIsoValue) const;
+        float toPlotX(int isoValue, int maxIsoValue) const;
+        float toPlotX(float fraction) const;
+        void zoom(int x, int delta, int maxIsoValue);
         bool isMouseOver();
         void drawControlPointCircles(int i);
         void drawHistogram();
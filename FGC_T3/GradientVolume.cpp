@@ -0,0 +1,381 @@
+#include "GradientVolume.h"
+#include "Parallel.h"
+#include "VoxelConverter.h"
+#include <emmintrin.h>
+
+GradientVolume::GradientVolume(void)
+{
+    size = glm::ivec3(0);
+    encoding = Octahedral8;
+    directions = nullptr;
+    magnitudes = nullptr;
+}
+
+GradientVolume::~GradientVolume(void)
+{
+}
+
+// neighbour offset and its weight on each derivative
+struct GradientTap {
+    glm::ivec3 offset;
+    glm::vec3 weight;
+};
+
+static std::vector<GradientTap> makeTaps(GradientVolume::Operator op)
+{
+    std::vector<GradientTap> taps;
+    glm::vec3 norm(0.f);
+
+    for (int dz = -1; dz <= 1; dz++) {
+        for (int dy = -1; dy <= 1; dy++) {
+            for (int dx = -1; dx <= 1; dx++) {
+                glm::vec3 d(dx, dy, dz);
+                glm::vec3 weight(0.f);
+
+                switch (op) {
+                    case GradientVolume::Sobel: {
+                        // smoothing weight 2 on the center line, 1 beside it
+                        glm::vec3 smooth = 2.f - glm::abs(d);
+                        weight = d * glm::vec3(smooth.y * smooth.z, smooth.x * smooth.z, smooth.x * smooth.y);
+                        break;
+                    }
+
+                    case GradientVolume::Regression:
+                        weight = dx || dy || dz ? d / glm::length(d) : glm::vec3(0.f);
+                        break;
+
+                    default:
+                        weight = std::abs(dx) + std::abs(dy) + std::abs(dz) == 1 ? d : glm::vec3(0.f);
+                        break;
+                }
+
+                if (weight == glm::vec3(0.f)) continue;
+
+                GradientTap tap = { glm::ivec3(dx, dy, dz), weight };
+                taps.push_back(tap);
+                norm += weight * d;
+            }
+        }
+    }
+
+    // a ramp rising one per voxel has a derivative of one
+    for (auto &tap : taps) tap.weight /= norm;
+
+    return taps;
+}
+
+void GradientVolume::compute(const VolumeData &volume, Operator op, Encoding encoding)
+{
+    clear();
+    size = glm::ivec3(volume.width(), volume.height(), volume.depth());
+    this->encoding = encoding;
+    storage.resize(directionBytes() + magnitudeBytes());
+    directions = &storage[0];
+    magnitudes = &storage[directionBytes()];
+    glm::ivec3 tiles = (size + glm::ivec3(TILE_SIZE - 1)) / TILE_SIZE;
+    parallelFor(0, tiles.x * tiles.y * tiles.z, [&](int first, int last) {
+        for (int t = first; t < last; t++) {
+            glm::ivec3 origin = glm::ivec3(t % tiles.x, (t / tiles.x) % tiles.y, t / (tiles.x * tiles.y)) * TILE_SIZE;
+
+            switch (volume.type()) {
+                case VolumeData::UInt16:
+                    computeTile<unsigned short>(volume, op, origin);
+                    break;
+
+                case VolumeData::Float32:
+                    computeTile<float>(volume, op, origin);
+                    break;
+
+                default:
+                    computeTile<unsigned char>(volume, op, origin);
+                    break;
+            }
+        }
+    });
+}
+
+template<typename T>
+void GradientVolume::computeTile(const VolumeData &volume, Operator op, const glm::ivec3 &origin)
+{
+    VoxelAccessor<T> clamped(volume);
+    const T *values = volume.as<T>();
+    std::vector<GradientTap> taps = makeTaps(op);
+    size_t rowSize = size.x;
+    size_t sliceSize = rowSize * size.y;
+    // the fast path reads raw values, normalized like VoxelAccessor does
+    float scale = std::numeric_limits<T>::is_integer ? 1.f / std::numeric_limits<T>::max() : 1.f;
+    std::vector<ptrdiff_t> offsets;
+    std::vector<glm::vec3> weights;
+
+    for (auto &tap : taps) {
+        offsets.push_back(tap.offset.x + tap.offset.y * (ptrdiff_t)rowSize + tap.offset.z * (ptrdiff_t)sliceSize);
+        weights.push_back(tap.weight * scale);
+    }
+
+    glm::ivec3 end = glm::min(origin + glm::ivec3(TILE_SIZE), size);
+    float gx[TILE_SIZE], gy[TILE_SIZE], gz[TILE_SIZE];
+    size_t directionSize = directionBytesPerVoxel(encoding);
+
+    for (int z = origin.z; z < end.z; z++) {
+        for (int y = origin.y; y < end.y; y++) {
+            size_t row = y * rowSize + z * sliceSize;
+            // voxels whose neighbours are all inside the volume
+            bool interiorRow = y > 0 && y < size.y - 1 && z > 0 && z < size.z - 1;
+
+            for (int x = origin.x; x < end.x; x++) {
+                glm::vec3 gradient(0.f);
+
+                if (interiorRow && x > 0 && x < size.x - 1) {
+                    const T *center = values + row + x;
+
+                    for (size_t t = 0; t < offsets.size(); t++) gradient += weights[t] * (float)center[offsets[t]];
+                } else {
+                    for (auto &tap : taps) gradient += tap.weight * clamped(x + tap.offset.x, y + tap.offset.y, z + tap.offset.z);
+                }
+
+                gx[x - origin.x] = gradient.x;
+                gy[x - origin.x] = gradient.y;
+                gz[x - origin.x] = gradient.z;
+            }
+
+            size_t first = row + origin.x;
+            encode(encoding, gx, gy, gz, end.x - origin.x, &storage[first * directionSize], &storage[directionBytes() + first]);
+        }
+    }
+}
+
+static int roundToInt(float value)
+{
+    return (int)(value + (value < 0.f ? -0.5f : 0.5f));
+}
+
+static float signNotZero(float value)
+{
+    return value < 0.f ? -1.f : 1.f;
+}
+
+static void encodeScalar(GradientVolume::Encoding encoding, const float *x, const float *y, const float *z, size_t first,
+                         size_t count, void *directions, unsigned char *magnitudes)
+{
+    float range = encoding == GradientVolume::Octahedral16 ? 32767.f : 127.f;
+
+    for (size_t i = first; i < count; i++) {
+        float l1 = std::abs(x[i]) + std::abs(y[i]) + std::abs(z[i]);
+        float inverseL1 = l1 > 0.f ? 1.f / l1 : 0.f;
+        float u = x[i] * inverseL1;
+        float v = y[i] * inverseL1;
+
+        // the lower hemisphere folds over the diagonals
+        if (z[i] < 0.f) {
+            float folded = (1.f - std::abs(v)) * signNotZero(u);
+            v = (1.f - std::abs(u)) * signNotZero(v);
+            u = folded;
+        }
+
+        if (encoding == GradientVolume::Octahedral16) {
+            ((short *)directions)[i * 2] = (short)roundToInt(u * range);
+            ((short *)directions)[i * 2 + 1] = (short)roundToInt(v * range);
+        } else {
+            ((signed char *)directions)[i * 2] = (signed char)roundToInt(u * range);
+            ((signed char *)directions)[i * 2 + 1] = (signed char)roundToInt(v * range);
+        }
+
+        float magnitude = std::sqrt(x[i] * x[i] + y[i] * y[i] + z[i] * z[i]);
+        magnitudes[i] = (unsigned char)roundToInt(std::min(magnitude, 1.f) * 255.f);
+    }
+}
+
+static void encodeSSE2(GradientVolume::Encoding encoding, const float *x, const float *y, const float *z, size_t count,
+                       void *directions, unsigned char *magnitudes)
+{
+    __m128 signMask = _mm_set1_ps(-0.f), one = _mm_set1_ps(1.f), zero = _mm_setzero_ps();
+    __m128 range = _mm_set1_ps(encoding == GradientVolume::Octahedral16 ? 32767.f : 127.f), magnitudeRange = _mm_set1_ps(255.f);
+    size_t i = 0;
+
+    for (; i + 4 <= count; i += 4) {
+        __m128 vx = _mm_loadu_ps(x + i), vy = _mm_loadu_ps(y + i), vz = _mm_loadu_ps(z + i);
+        __m128 ax = _mm_andnot_ps(signMask, vx), ay = _mm_andnot_ps(signMask, vy), az = _mm_andnot_ps(signMask, vz);
+        __m128 l1 = _mm_add_ps(_mm_add_ps(ax, ay), az);
+        __m128 nonZero = _mm_cmpgt_ps(l1, zero);
+        __m128 inverseL1 = _mm_and_ps(nonZero, _mm_div_ps(one, _mm_or_ps(l1, _mm_andnot_ps(nonZero, one))));
+        __m128 u = _mm_mul_ps(vx, inverseL1), v = _mm_mul_ps(vy, inverseL1);
+        // signNotZero as +-1 from the sign bit
+        __m128 signU = _mm_or_ps(_mm_and_ps(u, signMask), one), signV = _mm_or_ps(_mm_and_ps(v, signMask), one);
+        __m128 foldedU = _mm_mul_ps(_mm_sub_ps(one, _mm_andnot_ps(signMask, v)), signU);
+        __m128 foldedV = _mm_mul_ps(_mm_sub_ps(one, _mm_andnot_ps(signMask, u)), signV);
+        __m128 lower = _mm_cmplt_ps(vz, zero);
+        u = _mm_or_ps(_mm_and_ps(lower, foldedU), _mm_andnot_ps(lower, u));
+        v = _mm_or_ps(_mm_and_ps(lower, foldedV), _mm_andnot_ps(lower, v));
+        __m128i qu = _mm_cvtps_epi32(_mm_mul_ps(u, range)), qv = _mm_cvtps_epi32(_mm_mul_ps(v, range));
+        // u0 v0 u1 v1 u2 v2 u3 v3 as int16
+        __m128i uv = _mm_packs_epi32(_mm_unpacklo_epi32(qu, qv), _mm_unpackhi_epi32(qu, qv));
+
+        if (encoding == GradientVolume::Octahedral16) {
+            _mm_storeu_si128((__m128i *)((short *)directions + i * 2), uv);
+        } else {
+            _mm_storel_epi64((__m128i *)((signed char *)directions + i * 2), _mm_packs_epi16(uv, uv));
+        }
+
+        __m128 magnitude = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, vx), _mm_mul_ps(vy, vy)), _mm_mul_ps(vz, vz)));
+        __m128i qm = _mm_cvtps_epi32(_mm_mul_ps(_mm_min_ps(magnitude, one), magnitudeRange));
+        qm = _mm_packs_epi32(qm, qm);
+        int packed = _mm_cvtsi128_si32(_mm_packus_epi16(qm, qm));
+        memcpy(magnitudes + i, &packed, 4);
+    }
+
+    encodeScalar(encoding, x, y, z, i, count, directions, magnitudes);
+}
+
+void GradientVolume::encode(Encoding encoding, const float *x, const float *y, const float *z, size_t count, void *directions,
+                            unsigned char *magnitudes, bool simd)
+{
+    if (simd && VoxelConverter::detectIsa() >= VoxelConverter::SSE2) {
+        encodeSSE2(encoding, x, y, z, count, directions, magnitudes);
+    } else {
+        encodeScalar(encoding, x, y, z, 0, count, directions, magnitudes);
+    }
+}
+
+static void decodeScalar(GradientVolume::Encoding encoding, const void *directions, const unsigned char *magnitudes, size_t first,
+                         size_t count, glm::vec3 *dst)
+{
+    bool wide = encoding == GradientVolume::Octahedral16;
+    float inverseRange = wide ? 1.f / 32767.f : 1.f / 127.f;
+
+    for (size_t i = first; i < count; i++) {
+        glm::vec3 n;
+        n.x = (wide ? ((const short *)directions)[i * 2] : ((const signed char *)directions)[i * 2]) * inverseRange;
+        n.y = (wide ? ((const short *)directions)[i * 2 + 1] : ((const signed char *)directions)[i * 2 + 1]) * inverseRange;
+        n.z = 1.f - std::abs(n.x) - std::abs(n.y);
+        // unfolds the lower hemisphere without branches
+        float t = std::max(-n.z, 0.f);
+        n.x += n.x >= 0.f ? -t : t;
+        n.y += n.y >= 0.f ? -t : t;
+        dst[i] = n * (magnitudes[i] / 255.f / glm::length(n));
+    }
+}
+
+static void decodeSSE2(GradientVolume::Encoding encoding, const void *directions, const unsigned char *magnitudes, size_t count,
+                       glm::vec3 *dst)
+{
+    bool wide = encoding == GradientVolume::Octahedral16;
+    __m128 signMask = _mm_set1_ps(-0.f), one = _mm_set1_ps(1.f), zero = _mm_setzero_ps();
+    __m128 inverseRange = _mm_set1_ps(wide ? 1.f / 32767.f : 1.f / 127.f), inverseMagnitudeRange = _mm_set1_ps(1.f / 255.f);
+    size_t i = 0;
+
+    for (; i + 4 <= count; i += 4) {
+        __m128i uv;
+
+        if (wide) {
+            uv = _mm_loadu_si128((const __m128i *)((const short *)directions + i * 2));
+        } else {
+            // sign extends the bytes to int16 by unpacking them into the high half
+            __m128i bytes = _mm_loadl_epi64((const __m128i *)((const signed char *)directions + i * 2));
+            uv = _mm_srai_epi16(_mm_unpacklo_epi8(bytes, bytes), 8);
+        }
+
+        // u0 v0 u1 v1 ... to int32 pairs, then split u and v
+        __m128i low = _mm_srai_epi32(_mm_unpacklo_epi16(uv, uv), 16), high = _mm_srai_epi32(_mm_unpackhi_epi16(uv, uv), 16);
+        __m128 lowF = _mm_cvtepi32_ps(low), highF = _mm_cvtepi32_ps(high);
+        __m128 u = _mm_mul_ps(_mm_shuffle_ps(lowF, highF, _MM_SHUFFLE(2, 0, 2, 0)), inverseRange);
+        __m128 v = _mm_mul_ps(_mm_shuffle_ps(lowF, highF, _MM_SHUFFLE(3, 1, 3, 1)), inverseRange);
+        __m128 w = _mm_sub_ps(_mm_sub_ps(one, _mm_andnot_ps(signMask, u)), _mm_andnot_ps(signMask, v));
+        __m128 t = _mm_max_ps(_mm_sub_ps(zero, w), zero);
+        // x += x >= 0 ? -t : t, the sign of x flipped onto t
+        u = _mm_sub_ps(u, _mm_xor_ps(t, _mm_and_ps(u, signMask)));
+        v = _mm_sub_ps(v, _mm_xor_ps(t, _mm_and_ps(v, signMask)));
+        int packed;
+        memcpy(&packed, magnitudes + i, 4);
+        __m128i m = _mm_cvtsi32_si128(packed);
+        m = _mm_unpacklo_epi16(_mm_unpacklo_epi8(m, _mm_setzero_si128()), _mm_setzero_si128());
+        __m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(u, u), _mm_mul_ps(v, v)), _mm_mul_ps(w, w)));
+        __m128 scale = _mm_div_ps(_mm_mul_ps(_mm_cvtepi32_ps(m), inverseMagnitudeRange), length);
+        float xs[4], ys[4], zs[4];
+        _mm_storeu_ps(xs, _mm_mul_ps(u, scale));
+        _mm_storeu_ps(ys, _mm_mul_ps(v, scale));
+        _mm_storeu_ps(zs, _mm_mul_ps(w, scale));
+
+        for (int k = 0; k < 4; k++) dst[i + k] = glm::vec3(xs[k], ys[k], zs[k]);
+    }
+
+    decodeScalar(encoding, directions, magnitudes, i, count, dst);
+}
+
+void GradientVolume::decode(Encoding encoding, const void *directions, const unsigned char *magnitudes, size_t count, glm::vec3 *dst,
+                            bool simd)
+{
+    if (simd && VoxelConverter::detectIsa() >= VoxelConverter::SSE2) {
+        decodeSSE2(encoding, directions, magnitudes, count, dst);
+    } else {
+        decodeScalar(encoding, directions, magnitudes, 0, count, dst);
+    }
+}
+
+void GradientVolume::view(const glm::ivec3 &size, Encoding encoding, const void *directions, const void *magnitudes)
+{
+    clear();
+    this->size = size;
+    this->encoding = encoding;
+    this->directions = (const unsigned char *)directions;
+    this->magnitudes = (const unsigned char *)magnitudes;
+}
+
+void GradientVolume::clear()
+{
+    std::vector<unsigned char>().swap(storage);
+    directions = nullptr;
+    magnitudes = nullptr;
+    size = glm::ivec3(0);
+}
+
+glm::vec3 GradientVolume::gradient(int x, int y, int z) const
+{
+    size_t index = (size_t)x + ((size_t)y + (size_t)z * size.y) * size.x;
+    glm::vec3 decoded;
+    decode(encoding, directions + index * directionBytesPerVoxel(encoding), magnitudes + index, 1, &decoded, false);
+    return decoded;
+}
+
+void GradientVolume::benchmark()
+{
+    const size_t count = 1 << 22;
+    std::vector<float> x(count), y(count), z(count);
+
+    for (size_t i = 0; i < count; i++) {
+        // directions spiral over the whole sphere, magnitudes over their range
+        float h = 1.f - 2.f * (i + 0.5f) / count, r = std::sqrt(1.f - h * h), angle = i * 2.399963f;
+        float magnitude = (i % 256) / 255.f;
+        x[i] = r * std::cos(angle) * magnitude;
+        y[i] = r * std::sin(angle) * magnitude;
+        z[i] = h * magnitude;
+    }
+
+    std::vector<unsigned char> directions(count * 4), magnitudes(count);
+    std::vector<glm::vec3> decoded(count);
+
+    for (int e = Octahedral8; e <= Octahedral16; e++) {
+        for (int simd = 0; simd < 2; simd++) {
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            encode((Encoding)e, &x[0], &y[0], &z[0], count, &directions[0], &magnitudes[0], simd != 0);
+            std::chrono::steady_clock::time_point middle = std::chrono::steady_clock::now();
+            decode((Encoding)e, &directions[0], &magnitudes[0], count, &decoded[0], simd != 0);
+            std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+            float maxAngle = 0.f;
+
+            for (size_t i = 0; i < count; i++) {
+                glm::vec3 original(x[i], y[i], z[i]);
+
+                // directions of tiny gradients carry no shading weight
+                if (glm::length(original) < 0.1f) continue;
+
+                float cosine = glm::dot(glm::normalize(original), glm::normalize(decoded[i]));
+                maxAngle = std::max(maxAngle, glm::degrees(std::acos(std::min(cosine, 1.f))));
+            }
+
+            std::chrono::duration<double> encodeTime = middle - start, decodeTime = end - middle;
+            std::cout << (e == Octahedral16 ? "octahedral16 " : "octahedral8 ") << (simd ? "sse2" : "scalar") << ": encode "
+                      << count / encodeTime.count() / 1e6 << " Mvoxels/s, decode " << count / decodeTime.count() / 1e6
+                      << " Mvoxels/s, max error " << maxAngle << " degrees" << std::endl;
+        }
+    }
+}
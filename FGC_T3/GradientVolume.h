@@ -0,0 +1,98 @@
+#pragma once
+#include "Commons.h"
+#include "VolumeData.h"
+
+// gradients of a volume stored as an octahedral encoded direction, two
+// snorm8 or snorm16 components, plus a separate unorm8 magnitude plane so
+// both upload as textures as they are. computed in cubic tiles spread over
+// every core, interior voxels skip the border clamping. encoding and
+// decoding run four voxels at a time with sse2 where available
+class GradientVolume {
+    public:
+        enum Operator {
+            CentralDifference,
+            // 3^3 derivative of a [1 2 1] smoothed volume
+            Sobel,
+            // least squares fit of a linear function to the 26 neighbours,
+            // weighted by inverse distance
+            Regression
+        };
+
+        enum Encoding {
+            Octahedral8,
+            Octahedral16
+        };
+
+    private:
+        glm::ivec3 size;
+        Encoding encoding;
+        const unsigned char *directions;
+        const unsigned char *magnitudes;
+        std::vector<unsigned char> storage;
+
+        template<typename T>
+        void computeTile(const VolumeData &volume, Operator op, const glm::ivec3 &origin);
+
+        GradientVolume(const GradientVolume &);
+        GradientVolume &operator=(const GradientVolume &);
+    public:
+        // a tile and its one voxel apron stay in the l2 cache
+        static const int TILE_SIZE = 32;
+
+        static size_t directionBytesPerVoxel(Encoding encoding)
+        {
+            return encoding == Octahedral16 ? 4 : 2;
+        }
+        // gradients are x, y and z arrays of count voxels, the magnitude of
+        // a per voxel derivative is clamped to 1
+        static void encode(Encoding encoding, const float *x, const float *y, const float *z, size_t count, void *directions,
+                           unsigned char *magnitudes, bool simd = true);
+        // direction scaled by magnitude
+        static void decode(Encoding encoding, const void *directions, const unsigned char *magnitudes, size_t count, glm::vec3 *dst,
+                           bool simd = true);
+        // prints encode and decode throughput and error
+        static void benchmark();
+
+        void compute(const VolumeData &volume, Operator op = CentralDifference, Encoding encoding = Octahedral8);
+        // zero copy, both planes have to outlive this volume, i.e cache mappings
+        void view(const glm::ivec3 &size, Encoding encoding, const void *directions, const void *magnitudes);
+        void clear();
+        glm::vec3 gradient(int x, int y, int z) const;
+
+        const glm::ivec3 &getSize() const
+        {
+            return size;
+        }
+        Encoding getEncoding() const
+        {
+            return encoding;
+        }
+        const void *directionData() const
+        {
+            return directions;
+        }
+        const unsigned char *magnitudeData() const
+        {
+            return magnitudes;
+        }
+        size_t voxelCount() const
+        {
+            return (size_t)size.x * size.y * size.z;
+        }
+        size_t directionBytes() const
+        {
+            return voxelCount() * directionBytesPerVoxel(encoding);
+        }
+        size_t magnitudeBytes() const
+        {
+            return voxelCount();
+        }
+        bool empty() const
+        {
+            return directions == nullptr;
+        }
+
+        GradientVolume(void);
+        ~GradientVolume(void);
+};
+
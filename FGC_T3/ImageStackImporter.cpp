@@ -0,0 +1,213 @@
+#include "ImageStackImporter.h"
+#include "FreeImage.h"
+#include "MainData.h"
+
+static std::string extensionOf(const std::string &path)
+{
+    size_t dot = path.find_last_of('.');
+    std::string ext = dot == std::string::npos ? "" : path.substr(dot);
+    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+    return ext;
+}
+
+bool ImageStackImporter::isImageFile(const char *pszFilepath)
+{
+    std::string ext = extensionOf(pszFilepath);
+    return ext == ".png" || ext == ".tif" || ext == ".tiff" || ext == ".bmp";
+}
+
+// compares digit runs by value so numbered slices sort correctly
+static bool naturalLess(const std::string &a, const std::string &b)
+{
+    size_t i = 0, j = 0;
+
+    while (i < a.size() && j < b.size()) {
+        if (isdigit((unsigned char)a[i]) && isdigit((unsigned char)b[j])) {
+            size_t endA = a.find_first_not_of("0123456789", i);
+            size_t endB = b.find_first_not_of("0123456789", j);
+            endA = endA == std::string::npos ? a.size() : endA;
+            endB = endB == std::string::npos ? b.size() : endB;
+            unsigned long long valueA = std::stoull(a.substr(i, endA - i));
+            unsigned long long valueB = std::stoull(b.substr(j, endB - j));
+
+            if (valueA != valueB) return valueA < valueB;
+
+            i = endA;
+            j = endB;
+        } else {
+            if (tolower(a[i]) != tolower(b[j])) return tolower(a[i]) < tolower(b[j]);
+
+            i++;
+            j++;
+        }
+    }
+
+    return a.size() - i < b.size() - j;
+}
+
+std::vector<std::string> ImageStackImporter::listSlices(const char *pszFilepath)
+{
+    std::vector<std::string> slices;
+    std::string path(pszFilepath);
+    size_t slash = path.find_last_of("\\/");
+    std::string directory = slash == std::string::npos ? "" : path.substr(0, slash + 1);
+    std::string ext = extensionOf(path);
+    WIN32_FIND_DATA findData;
+    HANDLE find = FindFirstFile((directory + "*" + ext).c_str(), &findData);
+
+    if (find == INVALID_HANDLE_VALUE) return slices;
+
+    do {
+        if (!(findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) && extensionOf(findData.cFileName) == ext) {
+            slices.push_back(findData.cFileName);
+        }
+    } while (FindNextFile(find, &findData));
+
+    FindClose(find);
+    std::sort(slices.begin(), slices.end(), naturalLess);
+
+    for (auto &slice : slices) slice = directory + slice;
+
+    return slices;
+}
+
+// loads a slice as an 8, 16 bit or float greyscale image
+static FIBITMAP *loadSlice(const std::string &path)
+{
+    FREE_IMAGE_FORMAT fif = FreeImage_GetFileType(path.c_str(), 0);
+
+    if (fif == FIF_UNKNOWN) fif = FreeImage_GetFIFFromFilename(path.c_str());
+
+    if (fif == FIF_UNKNOWN || !FreeImage_FIFSupportsReading(fif)) return nullptr;
+
+    FIBITMAP *dib = FreeImage_Load(fif, path.c_str());
+
+    if (!dib) return nullptr;
+
+    FIBITMAP *converted = nullptr;
+
+    switch (FreeImage_GetImageType(dib)) {
+        case FIT_BITMAP:
+            if (FreeImage_GetBPP(dib) != 8 || FreeImage_GetColorType(dib) != FIC_MINISBLACK) {
+                converted = FreeImage_ConvertToGreyscale(dib);
+            }
+
+            break;
+
+        case FIT_UINT16:
+        case FIT_INT16:
+        case FIT_FLOAT:
+            break;
+
+        case FIT_RGB16:
+        case FIT_RGBA16:
+            converted = FreeImage_ConvertToType(dib, FIT_UINT16);
+            break;
+
+        default:
+            converted = FreeImage_ConvertToType(dib, FIT_FLOAT);
+            break;
+    }
+
+    if (converted) {
+        FreeImage_Unload(dib);
+        dib = converted;
+    }
+
+    return dib;
+}
+
+static VolumeData::VoxelType voxelTypeOf(FIBITMAP *dib)
+{
+    switch (FreeImage_GetImageType(dib)) {
+        case FIT_UINT16:
+        case FIT_INT16:
+            return VolumeData::UInt16;
+
+        case FIT_FLOAT:
+            return VolumeData::Float32;
+
+        default:
+            return VolumeData::UInt8;
+    }
+}
+
+// copies the scanlines top to bottom, freeimage stores them bottom up
+static void copySlice(FIBITMAP *dib, unsigned char *dst, size_t rowBytes, int height)
+{
+    bool isSigned = FreeImage_GetImageType(dib) == FIT_INT16;
+
+    for (int y = 0; y < height; y++) {
+        const BYTE *line = FreeImage_GetScanLine(dib, height - 1 - y);
+        unsigned char *row = dst + y * rowBytes;
+        memcpy(row, line, rowBytes);
+
+        if (isSigned) {
+            // signed values are moved to the unsigned range
+            unsigned short *values = (unsigned short *)row;
+
+            for (size_t x = 0; x < rowBytes / 2; x++) values[x] ^= 0x8000;
+        }
+    }
+}
+
+bool ImageStackImporter::import(const char *pszFilepath, VolumeData &volume)
+{
+    std::vector<std::string> slices = listSlices(pszFilepath);
+
+    if (slices.empty()) {
+        std::cout << "Error: no image slices found next to " << pszFilepath << std::endl;
+        return false;
+    }
+
+    // the first slice decides size and voxel type for the whole stack
+    FIBITMAP *first = loadSlice(slices[0]);
+
+    if (!first) {
+        std::cout << "Error: decoding " << slices[0] << " failed" << std::endl;
+        return false;
+    }
+
+    int width = FreeImage_GetWidth(first);
+    int height = FreeImage_GetHeight(first);
+    VolumeData::VoxelType type = voxelTypeOf(first);
+    FreeImage_Unload(first);
+    volume.allocate(type, width, height, (int)slices.size());
+    size_t rowBytes = width * volume.bytesPerVoxel();
+    size_t sliceBytes = rowBytes * height;
+    unsigned char *voxels = (unsigned char *)volume.mutableData();
+    std::atomic<int> nextSlice(0);
+    std::atomic<bool> failed(false);
+    std::vector<std::thread> decoders;
+    // slices are handed out one at a time, decode cost varies a lot per file
+    auto decode = [&]() {
+        for (int z = nextSlice++; z < (int)slices.size() && !failed; z = nextSlice++) {
+            FIBITMAP *dib = loadSlice(slices[z]);
+
+            if (!dib || (int)FreeImage_GetWidth(dib) != width || (int)FreeImage_GetHeight(dib) != height || voxelTypeOf(dib) != type) {
+                std::cout << "Error: slice " << slices[z] << " can't be decoded or doesn't match the first slice" << std::endl;
+                failed = true;
+            } else {
+                copySlice(dib, voxels + z * sliceBytes, rowBytes, height);
+            }
+
+            if (dib) FreeImage_Unload(dib);
+        }
+    };
+
+    for (int i = 1; i < MainData::AVAILABLE_CORES; i++) {
+        decoders.push_back(std::thread(decode));
+    }
+
+    decode();
+
+    for (auto &t : decoders) t.join();
+
+    if (failed) {
+        volume.clear();
+        return false;
+    }
+
+    std::cout << "OK: image stack of " << slices.size() << " slices " << width << "x" << height << " imported" << std::endl;
+    return true;
+}
@@ -0,0 +1,15 @@
+#pragma once
+#include "Commons.h"
+#include "VolumeData.h"
+
+// builds a volume out of a directory of per slice images, the slices are
+// every file in the directory sharing the extension of the picked one
+class ImageStackImporter {
+    public:
+        static bool isImageFile(const char *pszFilepath);
+        // slice paths sorted in natural order, slice_2 before slice_10
+        static std::vector<std::string> listSlices(const char *pszFilepath);
+        // decodes the slices concurrently, each one straight into its z slot
+        static bool import(const char *pszFilepath, VolumeData &volume);
+};
+
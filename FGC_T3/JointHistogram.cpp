@@ -0,0 +1,97 @@
+#include "JointHistogram.h"
+#include "Parallel.h"
+
+// largest central difference of normalized voxels, sqrt(3) / 2
+static const float MAX_GRADIENT = 0.8660254f;
+
+JointHistogram::JointHistogram(void)
+{
+}
+
+JointHistogram::~JointHistogram(void)
+{
+}
+
+int JointHistogram::gradientBin(float magnitude)
+{
+    return glm::clamp((int)(std::sqrt(magnitude * (1.f / MAX_GRADIENT)) * GRADIENT_BINS), 0, GRADIENT_BINS - 1);
+}
+
+template<typename T>
+void JointHistogram::count(const VolumeData &volume, int firstCut, int lastCut, std::array<unsigned int, 256> &values,
+                           unsigned int *joint) const
+{
+    VoxelAccessor<T> voxels(volume);
+    const T *raw = volume.as<T>();
+    int width = volume.width(), height = volume.height(), depth = volume.depth();
+    size_t sliceSize = (size_t)width * height;
+    // half of the central difference, applied to raw values
+    float scale = (std::numeric_limits<T>::is_integer ? 1.f / std::numeric_limits<T>::max() : 1.f) * 0.5f;
+
+    for (int z = firstCut; z < lastCut; z++) {
+        for (int y = 0; y < height; y++) {
+            size_t row = y * (size_t)width + z * sliceSize;
+            // voxels whose neighbours are all inside the volume
+            bool interiorRow = y > 0 && y < height - 1 && z > 0 && z < depth - 1;
+
+            for (int x = 0; x < width; x++) {
+                glm::vec3 gradient;
+
+                if (interiorRow && x > 0 && x < width - 1) {
+                    const T *center = raw + row + x;
+                    gradient = glm::vec3((float)center[1] - (float)center[-1], (float)center[width] - (float)center[-width],
+                                         (float)center[sliceSize] - (float)center[-(ptrdiff_t)sliceSize]) * scale;
+                } else {
+                    gradient = glm::vec3(voxels(x + 1, y, z) - voxels(x - 1, y, z), voxels(x, y + 1, z) - voxels(x, y - 1, z),
+                                         voxels(x, y, z + 1) - voxels(x, y, z - 1)) * 0.5f;
+                }
+
+                int value = glm::clamp((int)(voxels[row + x] * 255.f), 0, 255);
+                values[value]++;
+                joint[value + gradientBin(glm::length(gradient)) * VALUE_BINS]++;
+            }
+        }
+    }
+}
+
+void JointHistogram::build(const VolumeData &volume, std::array<unsigned int, 256> &values)
+{
+    bins.assign(VALUE_BINS * GRADIENT_BINS, 0);
+    values.fill(0);
+    std::mutex mergeMutex;
+    parallelFor(0, volume.depth(), [&](int firstCut, int lastCut) {
+        std::array<unsigned int, 256> localValues;
+        std::vector<unsigned int> localBins(bins.size(), 0);
+        localValues.fill(0);
+
+        switch (volume.type()) {
+            case VolumeData::UInt16:
+                count<unsigned short>(volume, firstCut, lastCut, localValues, &localBins[0]);
+                break;
+
+            case VolumeData::Float32:
+                count<float>(volume, firstCut, lastCut, localValues, &localBins[0]);
+                break;
+
+            default:
+                count<unsigned char>(volume, firstCut, lastCut, localValues, &localBins[0]);
+                break;
+        }
+
+        std::lock_guard<std::mutex> lock(mergeMutex);
+
+        for (int i = 0; i < 256; i++) values[i] += localValues[i];
+
+        for (size_t i = 0; i < bins.size(); i++) bins[i] += localBins[i];
+    });
+}
+
+void JointHistogram::assign(const unsigned int *counts)
+{
+    bins.assign(counts, counts + VALUE_BINS * GRADIENT_BINS);
+}
+
+void JointHistogram::clear()
+{
+    std::vector<unsigned int>().swap(bins);
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include "Commons.h"
+#include "VolumeData.h"
+
+// voxel counts over normalized value and gradient magnitude, the domain of
+// 2d transfer functions. built in the same pass as the 256 bin value
+// histogram, every thread counts a range of slices into its own bins and
+// the bins are summed once at the end
+class JointHistogram {
+    private:
+        // value bins of the first gradient bin, then the next
+        std::vector<unsigned int> bins;
+
+        template<typename T>
+        void count(const VolumeData &volume, int firstCut, int lastCut, std::array<unsigned int, 256> &values, unsigned int *joint) const;
+
+        JointHistogram(const JointHistogram &);
+        JointHistogram &operator=(const JointHistogram &);
+    public:
+        static const int VALUE_BINS = 256;
+        static const int GRADIENT_BINS = 256;
+
+        // central difference magnitude of normalized voxels to its bin. the
+        // square root spreads the weak gradients of most voxels over more bins
+        static int gradientBin(float magnitude);
+
+        // values is overwritten with the 1d histogram of the same voxels
+        void build(const VolumeData &volume, std::array<unsigned int, 256> &values);
+        // used when the counts come precomputed, i.e from the cache
+        void assign(const unsigned int *counts);
+        void clear();
+
+        unsigned int at(int value, int gradient) const
+        {
+            return bins[value + gradient * VALUE_BINS];
+        }
+        const unsigned int *data() const
+        {
+            return bins.empty() ? nullptr : &bins[0];
+        }
+        size_t sizeInBytes() const
+        {
+            return bins.size() * sizeof(unsigned int);
+        }
+        bool empty() const
+        {
+            return bins.empty();
+        }
+
+        JointHistogram(void);
+        ~JointHistogram(void);
+};
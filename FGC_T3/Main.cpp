@@ -2,6 +2,7 @@
 #include "RawDataModel.h"
 #include "MainData.h"
 #include "EditingWindow.h"
+#include "VoxelConverter.h"
 
 float deltaTime();
 // SFML Context Settings for OpenGL Rendering
@@ -24,8 +25,15 @@ unsigned int testValue;
 unsigned int controlPointCount = 0;
 bool arcBallOn = false;
 
-int main()
+int main(int argc, char **argv)
 {
+    // conversion and gradient coding throughput, no window is opened
+    if (argc > 1 && std::string(argv[1]) == "--benchmark") {
+        VoxelConverter::benchmark();
+        GradientVolume::benchmark();
+        return 0;
+    }
+
     sf::VideoMode desktop = sf::VideoMode::getDesktopMode();
     desktop.width = 1440;
     desktop.height = 900;
@@ -38,12 +46,15 @@ int main()
     // Setup MainEngine to hold important shader data
     rawModel = new RawDataModel();
     MainData::rootWindow = &window;
+    // histogram follows every volume swapped in by the background loader
+    rawModel->onVolumeLoaded = [] { eWindow.loadHistogram(); };
+    rawModel->onTimestepChanged = [] { eWindow.loadHistogram(); };
     // output available cores
     std::cout << "--- Available CPU Cores: " << MainData::AVAILABLE_CORES << std::endl;
     // Control Points
-    TransferFunction::addControlPoint(0, 0, 0, 0, 0);
-    TransferFunction::addControlPoint(255, 255, 255, 255, 255);
-    controlPointCount = TransferFunction::getControlPoints().size();
+    rawModel->transferFunction.addControlPoint(0, 0, 0, 0, 0);
+    rawModel->transferFunction.addControlPoint(255, 255, 255, 255, 255);
+    controlPointCount = rawModel->transferFunction.snapshot()->controlPoints.size();
     // start editing window
     gui.setHwnd(window.getSystemHandle());
     guiSetup(window, gui);
@@ -123,10 +134,21 @@ struct Callbacks {
     static void TW_CALL loadModelClick(void *clientData)
     {
         rawModel->load(rawModel->sModelName, rawModel->width, rawModel->height, rawModel->numCuts);
+    }
 
-        if (rawModel->isLoaded) {
-            eWindow.loadHistogram();
-        }
+    static void TW_CALL saveBrickedModelClick(void *clientData)
+    {
+        // paged volumes are bricked files already
+        if (!rawModel->isLoaded || rawModel->isPaged()) return;
+
+        std::string filename = rawModel->sModelName;
+        filename = filename.substr(0, filename.find_last_of('.')) + ".bvol";
+        const CompressedVolume &compressed = rawModel->getCompressedVolume();
+        VolumeData decompressed;
+
+        if (!compressed.empty()) compressed.decompress(decompressed);
+
+        BrickedVolume::convert(compressed.empty() ? rawModel->getVolume() : decompressed, filename.c_str());
     }
 
     static void TW_CALL loadTransferFunction(void *clientData)
@@ -141,7 +163,10 @@ struct Callbacks {
         eWindow.stop = true;
         jsoncons::json inFile = jsoncons::json::parse_file(filename);
         jsoncons::json controlPoints = inFile["Control Points"];
-        TransferFunction::Clear();
+        // files saved before iso values were in native units span 0 to 255
+        int maxIsoValue = inFile.has_member("Max IsoValue") ? inFile["Max IsoValue"].as<int>() : 255;
+        // published at once, the render thread never bakes half a file
+        std::vector<ControlPoint> loaded;
 
         for (int i = 0; i < controlPoints.size(); i++) {
             try {
@@ -151,15 +176,16 @@ struct Callbacks {
                 int style = controlPoint["Style"].as<int>();
                 // save values
                 rawModel->stf.availableStyles[i] = style;
-                TransferFunction::addControlPoint(opacity, opacity, opacity, opacity, isoValue);
+                TransferFunction::insertControlPoint(loaded, maxIsoValue, opacity, opacity, opacity, opacity, isoValue);
             } catch (const jsoncons::json_exception &e) {
                 std::cerr << e.what() << std::endl;
             }
         }
 
+        rawModel->transferFunction.assign(loaded, maxIsoValue);
         TwRemoveAllVars(gui.getBar("Control Points"));
 
-        for (int i = 0; i < TransferFunction::getControlPoints().size(); i++) {
+        for (int i = 0; i < loaded.size(); i++) {
             // gui.addColorControls("Funcion de Transferencia", "Punto " + std::to_string(i + 1), TransferFunction::getControlPointColors(i), "");
             gui.addTextList("Control Points", "Point " + std::to_string(i + 1), StyleTransfer::styleTextList, &rawModel->stf.availableStyles[i], "");
         }
@@ -179,17 +205,19 @@ struct Callbacks {
         jsoncons::json outFile;
         jsoncons::json stf(jsoncons::json::an_array);
         eWindow.stop = true;
+        std::shared_ptr<const TransferFunction::Snapshot> snapshot = rawModel->transferFunction.snapshot();
 
-        for (int i = 0; i < TransferFunction::getControlPoints().size(); i++) {
+        for (int i = 0; i < snapshot->controlPoints.size(); i++) {
             jsoncons::json controlPoint;
-            controlPoint["Opacity"] = (int)(TransferFunction::getControlPoint(i).rgba[3] * 255);
-            controlPoint["IsoValue"] = (int)TransferFunction::getControlPoint(i).isoValue;
+            controlPoint["Opacity"] = (int)(snapshot->controlPoints[i].rgba[3] * 255);
+            controlPoint["IsoValue"] = (int)snapshot->controlPoints[i].isoValue;
             controlPoint["Style"] = (int)rawModel->stf.availableStyles[i];
             // add to final json
             stf.add(controlPoint);
         }
 
         outFile["Control Points"] = stf;
+        outFile["Max IsoValue"] = snapshot->maxIsoValue;
         // save output to file
         std::ofstream outfile(filename);
         outfile << jsoncons::pretty_print(outFile);
@@ -204,18 +232,41 @@ void guiSetup(sf::Window &window, UIBuilder &gui)
     gui.init(window.getSize().x, window.getSize().y);
     // Model Loading
     gui.addBar("Volumetric Data");
-    gui.setBarPosition("Volumetric Data", 5, window.getSize().y - 155);
-    gui.setBarSize("Volumetric Data", 200, 130);
+    gui.setBarPosition("Volumetric Data", 5, window.getSize().y - 525);
+    gui.setBarSize("Volumetric Data", 200, 520);
     gui.addFileDialogButton("Volumetric Data", "Load from .RAW", rawModel->sModelName, "");
     gui.addTextfield("Volumetric Data", "Model name: ", &rawModel->sModelName, "");
     gui.addIntegerNumber("Volumetric Data", "Width", &rawModel->width, "");
     gui.addIntegerNumber("Volumetric Data", "Height", &rawModel->height, "");
     gui.addIntegerNumber("Volumetric Data", "Depth", &rawModel->numCuts, "");
+    gui.addIntegerNumber("Volumetric Data", "GPU budget (MB)", &rawModel->gpuBudgetMB, "min=16");
+    gui.addCheckbox("Volumetric Data", "Paged bricks", &rawModel->pagedBricks, "");
+    gui.addIntegerNumber("Volumetric Data", "RAM cache (MB)", &rawModel->cacheBudgetMB, "min=64");
+    gui.addCheckbox("Volumetric Data", "Compress CPU copy", &rawModel->compressCpuCopy, "");
+    gui.addCheckbox("Volumetric Data", "Precompute gradients", &rawModel->precomputeGradients, "");
+    gui.addTextList("Volumetric Data", "Gradient operator", "Central difference,Sobel,Regression", &rawModel->gradientOperator, "");
+    gui.addTextList("Volumetric Data", "Gradient encoding", "Octahedral 8 bit,Octahedral 16 bit", &rawModel->gradientEncoding, "");
+    gui.addIntegerNumber("Volumetric Data", "Smooth radius", &rawModel->smoothRadius, "min=0 max=8");
+    gui.addCheckbox("Volumetric Data", "Gaussian smoothing", &rawModel->gaussianSmoothing, "");
+    gui.addCheckbox("Volumetric Data", "Smooth scalars", &rawModel->smoothScalars, "");
+    gui.addCheckbox("Volumetric Data", "Gradient texture", &rawModel->useGradientTexture, "");
+    gui.addCheckbox("Volumetric Data", "Empty space skipping", &rawModel->emptySpaceSkipping, "");
+    gui.addCheckbox("Volumetric Data", "Pre-integration", &rawModel->preIntegrated, "");
+    gui.addFloatNumber("Volumetric Data", "Step size", &rawModel->stepSize, "min=0.0005 max=0.05 step=0.0005 precision=4");
+    gui.addFloatNumber("Volumetric Data", "Window low", &rawModel->windowLow, "min=0 max=1 step=0.01");
+    gui.addFloatNumber("Volumetric Data", "Window high", &rawModel->windowHigh, "min=0 max=1 step=0.01");
+    gui.addIntegerNumber("Volumetric Data", "Interaction LOD", &rawModel->interactionLevelBias, "min=0 max=4");
+    gui.addCheckbox("Volumetric Data", "Time series", &rawModel->timeSeries, "");
+    gui.addCheckbox("Volumetric Data", "Play", &rawModel->playTimeSeries, "");
+    gui.addFloatNumber("Volumetric Data", "Steps per second", &rawModel->timeSeriesRate, "min=0.1 max=60 step=0.5");
+    gui.addIntegerNumber("Volumetric Data", "Timestep", &rawModel->timestep, "readonly=true");
+    gui.addFloatNumber("Volumetric Data", "Loading (%)", &rawModel->loadProgress, "readonly=true precision=0");
     gui.addButton("Volumetric Data", "Load selected model", Callbacks::loadModelClick, NULL, "");
+    gui.addButton("Volumetric Data", "Save as .BVOL", Callbacks::saveBrickedModelClick, NULL, "");
     // transfer func save-load
     gui.addBar("Transfer Function");
     gui.setBarSize("Transfer Function", 200, 80);
-    gui.setBarPosition("Transfer Function", 5, window.getSize().y - 155 - 80 - 5);
+    gui.setBarPosition("Transfer Function", 5, window.getSize().y - 525 - 80 - 5);
     gui.addButton("Transfer Function", "Cargar de .TF", Callbacks::loadTransferFunction, NULL, "");
     gui.addButton("Transfer Function", "Guardar en .TF", Callbacks::saveTransferFunction, NULL, "");
     //transfer func
@@ -223,7 +274,7 @@ void guiSetup(sf::Window &window, UIBuilder &gui)
     gui.setBarSize("Control Points", 200, 500);
     gui.setBarPosition("Control Points", 5, 5);
 
-    for (int i = 0; i < TransferFunction::getControlPoints().size(); i++) {
+    for (int i = 0; i < controlPointCount; i++) {
         // gui.addColorControls("Funcion de Transferencia", "Punto " + std::to_string(i + 1), TransferFunction::getControlPointColors(i), "");
         gui.addTextList("Control Points", "Point " + std::to_string(i + 1), StyleTransfer::styleTextList, &rawModel->stf.availableStyles[i], "");
     }
@@ -308,6 +359,8 @@ void eventHandler(sf::Event &e, sf::RenderWindow &window)
             arcBallOn = false;
         }
 
+        rawModel->interacting = arcBallOn;
+
         if (sf::Keyboard::isKeyPressed(sf::Keyboard::W)) {
             currentAngle.x = currentAngle.x + 35;
         } else if (sf::Keyboard::isKeyPressed(sf::Keyboard::S)) {
@@ -319,15 +372,17 @@ void eventHandler(sf::Event &e, sf::RenderWindow &window)
         }
     }
 
-    if (controlPointCount != TransferFunction::getControlPoints().size()) {
+    size_t currentCount = rawModel->transferFunction.snapshot()->controlPoints.size();
+
+    if (controlPointCount != currentCount) {
         TwRemoveAllVars(gui.getBar("Control Points"));
 
-        for (int i = 0; i < TransferFunction::getControlPoints().size(); i++) {
+        for (int i = 0; i < currentCount; i++) {
             // gui.addColorControls("Funcion de Transferencia", "Punto " + std::to_string(i + 1), TransferFunction::getControlPointColors(i), "");
             gui.addTextList("Control Points", "Point " + std::to_string(i + 1), StyleTransfer::styleTextList, &rawModel->stf.availableStyles[i], "");
         }
 
-        controlPointCount = TransferFunction::getControlPoints().size();
+        controlPointCount = currentCount;
     }
 
     if (currentAngle != initialAngle) {
@@ -357,6 +412,8 @@ void Render(sf::RenderWindow &window, sf::Clock &frameClock)
         eventHandler(sf::Event(), window);
         // clear previous drawings
         window.clear();
+        // finish background loads
+        rawModel->update();
         // Render OpenGL
         rawModel->render();
         // draw ui
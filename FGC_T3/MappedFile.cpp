@@ -0,0 +1,95 @@
+#include "MappedFile.h"
+
+MappedFile::MappedFile(void)
+{
+    fileHandle = INVALID_HANDLE_VALUE;
+    mappingHandle = NULL;
+    view = nullptr;
+    fileSize = 0;
+}
+
+MappedFile::~MappedFile(void)
+{
+    close();
+}
+
+bool MappedFile::open(const char *pszFilepath)
+{
+    close();
+    // sequential scan hint lets the os read ahead aggressively
+    fileHandle = CreateFile(pszFilepath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                            FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+
+    if (fileHandle == INVALID_HANDLE_VALUE) {
+        std::cout << "Error: opening " << pszFilepath << " file failed" << std::endl;
+        return false;
+    }
+
+    LARGE_INTEGER length;
+
+    if (!GetFileSizeEx(fileHandle, &length) || length.QuadPart == 0) {
+        std::cout << "Error: " << pszFilepath << " is empty" << std::endl;
+        close();
+        return false;
+    }
+
+    fileSize = (size_t)length.QuadPart;
+    mappingHandle = CreateFileMapping(fileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+
+    if (mappingHandle == NULL) {
+        std::cout << "Error: mapping " << pszFilepath << " file failed" << std::endl;
+        close();
+        return false;
+    }
+
+    view = (const unsigned char *)MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+
+    if (view == nullptr) {
+        std::cout << "Error: mapping view of " << pszFilepath << " failed" << std::endl;
+        close();
+        return false;
+    }
+
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (view) {
+        UnmapViewOfFile(view);
+        view = nullptr;
+    }
+
+    if (mappingHandle) {
+        CloseHandle(mappingHandle);
+        mappingHandle = NULL;
+    }
+
+    if (fileHandle != INVALID_HANDLE_VALUE) {
+        CloseHandle(fileHandle);
+        fileHandle = INVALID_HANDLE_VALUE;
+    }
+
+    fileSize = 0;
+}
+
+void MappedFile::prefetch(size_t offset, size_t length) const
+{
+    if (!view || offset >= fileSize) return;
+
+    touch(view + offset, std::min(fileSize - offset, length));
+}
+
+void MappedFile::touch(const unsigned char *data, size_t length)
+{
+    if (!data || length == 0) return;
+
+    static const size_t pageSize = 4096;
+    volatile unsigned char sink = 0;
+
+    for (size_t i = 0; i < length; i += pageSize) {
+        sink += data[i];
+    }
+
+    sink += data[length - 1];
+}
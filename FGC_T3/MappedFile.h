@@ -0,0 +1,41 @@
+#pragma once
+#include "Commons.h"
+
+// read-only memory mapped view of a whole file, the pages
+// are only brought in by the os when they are first touched
+class MappedFile {
+    private:
+        HANDLE fileHandle;
+        HANDLE mappingHandle;
+        const unsigned char *view;
+        size_t fileSize;
+
+        MappedFile(const MappedFile &);
+        MappedFile &operator=(const MappedFile &);
+    public:
+        bool open(const char *pszFilepath);
+        void close();
+        // touches every page on the given range so later readers don't stall on disk
+        void prefetch(size_t offset, size_t length) const;
+        // same for any mapped range, i.e volumes viewed from a mapping
+        static void touch(const unsigned char *data, size_t length);
+
+        const unsigned char *data() const
+        {
+            return view;
+        }
+
+        size_t size() const
+        {
+            return fileSize;
+        }
+
+        bool isOpen() const
+        {
+            return view != nullptr;
+        }
+
+        MappedFile(void);
+        ~MappedFile(void);
+};
+
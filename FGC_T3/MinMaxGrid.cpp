@@ -0,0 +1,77 @@
+#include "MinMaxGrid.h"
+#include "Parallel.h"
+
+MinMaxGrid::MinMaxGrid(void)
+{
+    size = glm::ivec3(0);
+    cellSize = DEFAULT_CELL_SIZE;
+}
+
+MinMaxGrid::~MinMaxGrid(void)
+{
+}
+
+void MinMaxGrid::build(const VolumeData &volume, int cellSize)
+{
+    glm::ivec3 volumeSize(volume.width(), volume.height(), volume.depth());
+    this->cellSize = cellSize;
+    size = (volumeSize + glm::ivec3(cellSize - 1)) / cellSize;
+    cells.assign((size_t)size.x * size.y * size.z, glm::vec2(0.f));
+
+    switch (volume.type()) {
+        case VolumeData::UInt16:
+            build(VoxelAccessor<unsigned short>(volume), volumeSize);
+            break;
+
+        case VolumeData::Float32:
+            build(VoxelAccessor<float>(volume), volumeSize);
+            break;
+
+        default:
+            build(VoxelAccessor<unsigned char>(volume), volumeSize);
+            break;
+    }
+}
+
+template<typename T>
+void MinMaxGrid::build(const VoxelAccessor<T> &voxels, const glm::ivec3 &volumeSize)
+{
+    parallelFor(0, size.z, [&](int first, int last) {
+        for (int cz = first; cz < last; cz++) {
+            for (int cy = 0; cy < size.y; cy++) {
+                for (int cx = 0; cx < size.x; cx++) {
+                    glm::ivec3 origin = glm::ivec3(cx, cy, cz) * cellSize;
+                    // one voxel before and past the cell, the first half voxel
+                    // of a cell also blends the last voxel of the previous one
+                    glm::ivec3 low = glm::max(origin - 1, glm::ivec3(0));
+                    glm::ivec3 high = glm::min(origin + glm::ivec3(cellSize + 1), volumeSize);
+                    glm::vec2 range(std::numeric_limits<float>::max(), -std::numeric_limits<float>::max());
+
+                    for (int z = low.z; z < high.z; z++) {
+                        for (int y = low.y; y < high.y; y++) {
+                            for (int x = low.x; x < high.x; x++) {
+                                float value = voxels(x, y, z);
+                                range = glm::vec2(std::min(range.x, value), std::max(range.y, value));
+                            }
+                        }
+                    }
+
+                    cells[cx + (cy + cz * size.y) * size.x] = range;
+                }
+            }
+        }
+    });
+}
+
+void MinMaxGrid::assign(const glm::ivec3 &size, int cellSize, const glm::vec2 *ranges)
+{
+    this->size = size;
+    this->cellSize = cellSize;
+    cells.assign(ranges, ranges + (size_t)size.x * size.y * size.z);
+}
+
+void MinMaxGrid::clear()
+{
+    cells.clear();
+    size = glm::ivec3(0);
+}
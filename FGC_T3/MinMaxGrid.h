@@ -0,0 +1,54 @@
+#pragma once
+#include "Commons.h"
+#include "VolumeData.h"
+
+// normalized min and max of every cellSize^3 block of a volume. cells
+// include the nearest voxel row of their neighbours on both sides so a
+// linear sample taken anywhere inside a cell stays within its range
+class MinMaxGrid {
+    private:
+        glm::ivec3 size;
+        int cellSize;
+        std::vector<glm::vec2> cells;
+
+        template<typename T>
+        void build(const VoxelAccessor<T> &voxels, const glm::ivec3 &volumeSize);
+
+        MinMaxGrid(const MinMaxGrid &);
+        MinMaxGrid &operator=(const MinMaxGrid &);
+    public:
+        static const int DEFAULT_CELL_SIZE = 8;
+
+        void build(const VolumeData &volume, int cellSize = DEFAULT_CELL_SIZE);
+        // used when the ranges come precomputed, i.e from the cache
+        void assign(const glm::ivec3 &size, int cellSize, const glm::vec2 *ranges);
+        void clear();
+
+        const glm::ivec3 &getSize() const
+        {
+            return size;
+        }
+        int getCellSize() const
+        {
+            return cellSize;
+        }
+        const glm::vec2 &cell(int x, int y, int z) const
+        {
+            return cells[x + (y + z * size.y) * size.x];
+        }
+        const glm::vec2 *data() const
+        {
+            return cells.empty() ? nullptr : &cells[0];
+        }
+        size_t cellCount() const
+        {
+            return cells.size();
+        }
+        bool empty() const
+        {
+            return cells.empty();
+        }
+
+        MinMaxGrid(void);
+        ~MinMaxGrid(void);
+};
@@ -0,0 +1,74 @@
+#include "OccupancyGrid.h"
+#include "Parallel.h"
+
+OccupancyGrid::OccupancyGrid(void)
+{
+    size = glm::ivec3(0);
+}
+
+OccupancyGrid::~OccupancyGrid(void)
+{
+}
+
+void OccupancyGrid::build(const MinMaxGrid &ranges, const float *opacity, int count, int dilation)
+{
+    size = ranges.getSize();
+    cells.assign((size_t)size.x * size.y * size.z, 0);
+    // visible texels up to each one, any range is then checked in constant time
+    std::vector<int> visibleBefore(count + 1, 0);
+
+    for (int i = 0; i < count; i++) visibleBefore[i + 1] = visibleBefore[i] + (opacity[i] > 0.f ? 1 : 0);
+
+    std::vector<unsigned char> visible(cells.size());
+    parallelFor(0, size.z, [&](int first, int last) {
+        for (int z = first; z < last; z++) {
+            for (int y = 0; y < size.y; y++) {
+                for (int x = 0; x < size.x; x++) {
+                    const glm::vec2 &range = ranges.cell(x, y, z);
+                    // nearest entries, as fetched by the ray caster
+                    int low = glm::clamp((int)(range.x * (count - 1) + 0.5f), 0, count - 1);
+                    int high = glm::clamp((int)(range.y * (count - 1) + 0.5f), 0, count - 1);
+                    visible[x + (y + (size_t)z * size.y) * size.x] = visibleBefore[high + 1] > visibleBefore[low] ? 255 : 0;
+                }
+            }
+        }
+    });
+
+    if (dilation <= 0) {
+        cells.swap(visible);
+        return;
+    }
+
+    parallelFor(0, size.z, [&](int first, int last) {
+        for (int z = first; z < last; z++) {
+            for (int y = 0; y < size.y; y++) {
+                for (int x = 0; x < size.x; x++) {
+                    glm::ivec3 low = glm::max(glm::ivec3(x, y, z) - dilation, glm::ivec3(0));
+                    glm::ivec3 high = glm::min(glm::ivec3(x, y, z) + dilation, size - 1);
+                    unsigned char value = 0;
+
+                    for (int nz = low.z; nz <= high.z && !value; nz++) {
+                        for (int ny = low.y; ny <= high.y && !value; ny++) {
+                            for (int nx = low.x; nx <= high.x && !value; nx++) {
+                                value = visible[nx + (ny + (size_t)nz * size.y) * size.x];
+                            }
+                        }
+                    }
+
+                    cells[x + (y + (size_t)z * size.y) * size.x] = value;
+                }
+            }
+        }
+    });
+}
+
+void OccupancyGrid::clear()
+{
+    cells.clear();
+    size = glm::ivec3(0);
+}
+
+size_t OccupancyGrid::visibleCount() const
+{
+    return std::count(cells.begin(), cells.end(), (unsigned char)255);
+}
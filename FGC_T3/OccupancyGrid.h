@@ -0,0 +1,38 @@
+#pragma once
+#include "Commons.h"
+#include "MinMaxGrid.h"
+
+// one byte per MinMaxGrid cell, 255 where the transfer function gives any
+// voxel of the cell some opacity. rebuilt on the cpu when the opacity
+// changes, the ray caster leaps over the cells left at 0
+class OccupancyGrid {
+    private:
+        glm::ivec3 size;
+        std::vector<unsigned char> cells;
+
+        OccupancyGrid(const OccupancyGrid &);
+        OccupancyGrid &operator=(const OccupancyGrid &);
+    public:
+        // opacity has count entries sampled like the transfer function
+        // texture, entry i at value i / (count - 1). dilation marks that many
+        // neighbour cells visible too, for levels coarser than the one of ranges
+        void build(const MinMaxGrid &ranges, const float *opacity, int count, int dilation);
+        void clear();
+
+        const glm::ivec3 &getSize() const
+        {
+            return size;
+        }
+        const unsigned char *data() const
+        {
+            return cells.empty() ? nullptr : &cells[0];
+        }
+        size_t visibleCount() const;
+        bool empty() const
+        {
+            return cells.empty();
+        }
+
+        OccupancyGrid(void);
+        ~OccupancyGrid(void);
+};
@@ -0,0 +1,27 @@
+#pragma once
+#include "Commons.h"
+#include "MainData.h"
+
+// splits [begin, end) in contiguous chunks, one per available core,
+// and calls func(chunkBegin, chunkEnd) for each of them concurrently
+template<typename Func>
+void parallelFor(int begin, int end, Func func)
+{
+    int count = end - begin;
+
+    if (count <= 0) return;
+
+    int workers = std::max(1, std::min(MainData::AVAILABLE_CORES, count));
+    int chunk = (count + workers - 1) / workers;
+    std::vector<std::thread> threads;
+
+    for (int start = begin + chunk; start < end; start += chunk) {
+        threads.push_back(std::thread(func, start, std::min(end, start + chunk)));
+    }
+
+    // the calling thread takes the first chunk
+    func(begin, std::min(end, begin + chunk));
+
+    for (auto &t : threads) t.join();
+}
+
@@ -0,0 +1,53 @@
+#include "PreIntegrationTable.h"
+#include "Parallel.h"
+
+const float PreIntegrationTable::REFERENCE_STEP = 0.001f;
+
+// opacity of one is never reached, its extinction stays finite
+static const float MAX_OPACITY = 0.9999f;
+
+PreIntegrationTable::PreIntegrationTable(void)
+{
+    size = 0;
+}
+
+PreIntegrationTable::~PreIntegrationTable(void)
+{
+}
+
+void PreIntegrationTable::build(const glm::vec2 *lut, int size, float stepSize)
+{
+    this->size = size;
+    entries.resize((size_t)size * size);
+    // extinction per unit length and its running integral over the values
+    std::vector<double> extinction(size), extinctionSum(size, 0.0);
+
+    for (int i = 0; i < size; i++) {
+        extinction[i] = -std::log(1.0 - std::min(std::max(lut[i].y, 0.f), MAX_OPACITY)) / REFERENCE_STEP;
+    }
+
+    // trapezoids between neighbour entries, the lut is linear in between
+    for (int i = 1; i < size; i++) {
+        extinctionSum[i] = extinctionSum[i - 1] + 0.5 * (extinction[i - 1] + extinction[i]);
+    }
+
+    parallelFor(0, size, [&](int first, int last) {
+        for (int front = first; front < last; front++) {
+            // style indices aren't averaged, a blend of two styles is some
+            // unrelated third one. the densest entry of the segment gives its
+            // index, found sweeping away from the front value both ways
+            for (int direction = -1; direction <= 1; direction += 2) {
+                int densest = front;
+
+                for (int back = front; back >= 0 && back < size; back += direction) {
+                    if (extinction[back] > extinction[densest]) densest = back;
+
+                    int low = std::min(front, back), high = std::max(front, back);
+                    double length = high - low;
+                    double tau = length > 0.0 ? (extinctionSum[high] - extinctionSum[low]) / length : extinction[low];
+                    entries[back + (size_t)front * size] = glm::vec2(lut[densest].x, (float)(1.0 - std::exp(-tau * stepSize)));
+                }
+            }
+        }
+    });
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include "Commons.h"
+
+// style index and opacity of a ray segment between a front and a back
+// value. the opacity is integrated over the transfer function in between
+// so thin features aren't missed by large steps, the index is the one of
+// the most opaque value in between and has to be fetched unfiltered.
+// entries are opacity corrected for the step they were built for, an
+// opacity in the transfer function is the one of a REFERENCE_STEP long
+// segment
+class PreIntegrationTable {
+    private:
+        // front value along rows, back value along columns
+        std::vector<glm::vec2> entries;
+        int size;
+
+        PreIntegrationTable(const PreIntegrationTable &);
+        PreIntegrationTable &operator=(const PreIntegrationTable &);
+    public:
+        static const float REFERENCE_STEP;
+        // largest lut tabulated, finer ones would need size^2 entries
+        static const int MAX_SIZE = 256;
+
+        // lut holds size (index, opacity) entries, like the transfer
+        // function texture
+        void build(const glm::vec2 *lut, int size, float stepSize);
+
+        int getSize() const
+        {
+            return size;
+        }
+        const glm::vec2 *data() const
+        {
+            return entries.empty() ? nullptr : &entries[0];
+        }
+        const glm::vec2 &at(int front, int back) const
+        {
+            return entries[back + front * size];
+        }
+
+        PreIntegrationTable(void);
+        ~PreIntegrationTable(void);
+};
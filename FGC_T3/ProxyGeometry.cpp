@@ -0,0 +1,91 @@
+#include "ProxyGeometry.h"
+
+ProxyGeometry::ProxyGeometry(void)
+{
+    clear();
+}
+
+ProxyGeometry::~ProxyGeometry(void)
+{
+}
+
+void ProxyGeometry::addFace(const glm::vec3 &corner, int axis, bool positive, const glm::vec3 &extent)
+{
+    // the two other axes in the order that makes the face counter clockwise
+    // seen from outside
+    int u = positive ? (axis + 1) % 3 : (axis + 2) % 3;
+    int v = positive ? (axis + 2) % 3 : (axis + 1) % 3;
+    glm::vec3 origin = corner;
+
+    if (positive) origin[axis] += extent[axis];
+
+    glm::vec3 du(0.f), dv(0.f);
+    du[u] = extent[u];
+    dv[v] = extent[v];
+    unsigned int first = (unsigned int)vertices.size();
+    vertices.push_back(origin);
+    vertices.push_back(origin + du);
+    vertices.push_back(origin + du + dv);
+    vertices.push_back(origin + dv);
+    unsigned int quad[6] = { first, first + 1, first + 2, first + 2, first + 3, first };
+    indices.insert(indices.end(), quad, quad + 6);
+}
+
+void ProxyGeometry::build(const OccupancyGrid &occupancy, const glm::vec3 &cellSize, int brickCells)
+{
+    clear();
+    const glm::ivec3 &cells = occupancy.getSize();
+    glm::ivec3 bricks = (cells + glm::ivec3(brickCells - 1)) / brickCells;
+    std::vector<unsigned char> visible((size_t)bricks.x * bricks.y * bricks.z, 0);
+    const unsigned char *cellData = occupancy.data();
+
+    for (int z = 0; z < cells.z; z++) {
+        for (int y = 0; y < cells.y; y++) {
+            for (int x = 0; x < cells.x; x++) {
+                if (!cellData[x + (y + (size_t)z * cells.y) * cells.x]) continue;
+
+                glm::ivec3 brick = glm::ivec3(x, y, z) / brickCells;
+                visible[brick.x + (brick.y + (size_t)brick.z * bricks.y) * bricks.x] = 1;
+            }
+        }
+    }
+
+    auto isVisible = [&](const glm::ivec3 & brick) {
+        if (glm::any(glm::lessThan(brick, glm::ivec3(0))) || glm::any(glm::greaterThanEqual(brick, bricks))) return false;
+
+        return visible[brick.x + (brick.y + (size_t)brick.z * bricks.y) * bricks.x] != 0;
+    };
+
+    for (int z = 0; z < bricks.z; z++) {
+        for (int y = 0; y < bricks.y; y++) {
+            for (int x = 0; x < bricks.x; x++) {
+                glm::ivec3 brick(x, y, z);
+
+                if (!isVisible(brick)) continue;
+
+                // the last bricks end at the volume border
+                glm::vec3 corner = glm::vec3(brick * brickCells) * cellSize;
+                glm::vec3 extent = glm::min(glm::vec3((brick + 1) * brickCells) * cellSize, glm::vec3(1.f)) - corner;
+                boundsMin = glm::min(boundsMin, corner);
+                boundsMax = glm::max(boundsMax, corner + extent);
+
+                for (int axis = 0; axis < 3; axis++) {
+                    glm::ivec3 step(0);
+                    step[axis] = 1;
+
+                    if (!isVisible(brick - step)) addFace(corner, axis, false, extent);
+
+                    if (!isVisible(brick + step)) addFace(corner, axis, true, extent);
+                }
+            }
+        }
+    }
+}
+
+void ProxyGeometry::clear()
+{
+    vertices.clear();
+    indices.clear();
+    boundsMin = glm::vec3(std::numeric_limits<float>::max());
+    boundsMax = glm::vec3(-std::numeric_limits<float>::max());
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include "Commons.h"
+#include "OccupancyGrid.h"
+
+// triangles around the visible bricks of an occupancy grid, in normalized
+// volume coordinates like the unit cube they replace. only faces between
+// a visible brick and an empty one or the volume border are kept, so rays
+// enter at the nearest front face and leave at the farthest back face
+class ProxyGeometry {
+    private:
+        std::vector<glm::vec3> vertices;
+        std::vector<unsigned int> indices;
+        glm::vec3 boundsMin;
+        glm::vec3 boundsMax;
+
+        void addFace(const glm::vec3 &corner, int axis, bool positive, const glm::vec3 &extent);
+
+        ProxyGeometry(const ProxyGeometry &);
+        ProxyGeometry &operator=(const ProxyGeometry &);
+    public:
+        // occupancy cells merged per brick side, fewer faces for a looser fit
+        static const int DEFAULT_BRICK_CELLS = 4;
+
+        // cellSize is the normalized extent of an occupancy cell
+        void build(const OccupancyGrid &occupancy, const glm::vec3 &cellSize, int brickCells = DEFAULT_BRICK_CELLS);
+        void clear();
+
+        const std::vector<glm::vec3> &getVertices() const
+        {
+            return vertices;
+        }
+        const std::vector<unsigned int> &getIndices() const
+        {
+            return indices;
+        }
+        // tight box around the visible bricks, empty when min > max
+        const glm::vec3 &getBoundsMin() const
+        {
+            return boundsMin;
+        }
+        const glm::vec3 &getBoundsMax() const
+        {
+            return boundsMax;
+        }
+        bool empty() const
+        {
+            return indices.empty();
+        }
+
+        ProxyGeometry(void);
+        ~ProxyGeometry(void);
+};
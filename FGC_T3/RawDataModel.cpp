@@ -13,7 +13,41 @@ RawDataModel::RawDataModel(void)
     frameBuffer = 0;
     vertexBuffer = 0;
     transferFunctionTexture = 0;
-    volumeTexture = 0;
+    asset.reset(new VolumeAsset());
+    previewTexture = 0;
+    gpuBudgetMB = 1024;
+    pagedBricks = false;
+    cacheBudgetMB = 1024;
+    compressCpuCopy = false;
+    precomputeGradients = false;
+    gradientOperator = GradientVolume::CentralDifference;
+    gradientEncoding = GradientVolume::Octahedral8;
+    useGradientTexture = true;
+    emptySpaceSkipping = true;
+    occupancyTexture = 0;
+    occupancyChanged = true;
+    occupancyDilation = 0;
+    occupancyBake = 0;
+    proxyArray = 0;
+    proxyBuffers[0] = proxyBuffers[1] = 0;
+    skipEmptySpace = false;
+    preIntegrated = true;
+    preIntegrate = false;
+    preIntegrationTexture = 0;
+    preIntegrationBake = 0;
+    preIntegrationStep = 0.f;
+    smoothRadius = 0;
+    gaussianSmoothing = true;
+    smoothScalars = false;
+    windowLow = 0.f;
+    windowHigh = 1.f;
+    interactionLevelBias = 1;
+    interacting = false;
+    loadProgress = 0.f;
+    timeSeries = false;
+    playTimeSeries = false;
+    timeSeriesRate = 10.f;
+    timestep = 0;
 
     for (int i = 0; i < 256; i++) transferFunc[i] = glm::vec4((float)i / 255.f);
 
@@ -27,27 +61,41 @@ RawDataModel::~RawDataModel(void)
 {
     isLoaded = false;
     glDeleteTextures(1, &transferFunctionTexture);
-    glDeleteTextures(1, &volumeTexture);
-    free(dataScalars);
-    dataScalars = nullptr;
+
+    if (occupancyTexture != 0) glDeleteTextures(1, &occupancyTexture);
+
+    if (preIntegrationTexture != 0) glDeleteTextures(1, &preIntegrationTexture);
+
+    if (proxyArray != 0) {
+        glDeleteVertexArrays(1, &proxyArray);
+        glDeleteBuffers(2, proxyBuffers);
+    }
+
+    discardPreview();
+    releaseVolume();
 }
 
-void RawDataModel::load(const char *pszFilepath, int width, int height, int numCuts)
+void RawDataModel::releaseVolume()
 {
-    isLoaded = false;
+    series.stop();
+    pager.release();
 
-    // Initialize VBO for rendering Volume
-    if (!createVertexBuffer()) {
-        return;
+    if (!asset->textures.empty()) {
+        glDeleteTextures((GLsizei)asset->textures.size(), &asset->textures[0]);
     }
 
-    // Load Volume data on 3D texture
-    if (!loadVolumeFromFile8(pszFilepath, width, height, numCuts)) {
+    if (asset->gradientTexture != 0) glDeleteTextures(1, &asset->gradientTexture);
+
+    if (asset->gradientMagnitudeTexture != 0) glDeleteTextures(1, &asset->gradientMagnitudeTexture);
+
+    asset.reset(new VolumeAsset());
+}
+
+void RawDataModel::load(const char *pszFilepath, int width, int height, int numCuts)
+{
+    // Initialize VBO for rendering Volume
+    if (!createVertexBuffer()) {
         return;
-    } else {
-        // gradients = new glm::vec3[width * height * numCuts];
-        // generateGradients(1);
-        // filterNxNxN(3);
     }
 
     // Initialize texture for backface
@@ -60,12 +108,177 @@ void RawDataModel::load(const char *pszFilepath, int width, int height, int numC
         return;
     }
 
-    // Success
-    this->width = width;
-    this->height = height;
-    this->numCuts = numCuts;
-    float maxSize = std::max(std::max(width, height), numCuts);
-    cubeSizes = glm::vec3(width / maxSize, height / maxSize, numCuts / maxSize);
+    VolumeLoader::Options options;
+    glGetIntegerv(GL_MAX_3D_TEXTURE_SIZE, &options.maxTextureSize);
+    options.budgetBytes = (size_t)std::max(0, gpuBudgetMB) << 20;
+    options.window = glm::vec2(windowLow, windowHigh);
+    options.paged = pagedBricks;
+    options.compress = compressCpuCopy;
+    options.gradients = precomputeGradients;
+    options.gradientOperator = (GradientVolume::Operator)gradientOperator;
+    options.gradientEncoding = (GradientVolume::Encoding)gradientEncoding;
+    options.smoothing = gaussianSmoothing ? VolumeFilter::Gaussian : VolumeFilter::Box;
+    options.smoothRadius = smoothRadius;
+    options.smoothScalars = smoothScalars;
+
+    // Load Volume data on a background thread, update picks it up
+    if (!loader.start(pszFilepath, width, height, numCuts, options)) {
+        return;
+    }
+
+    // copy asset location
+    memcpy(sModelName, pszFilepath, 1024);
+}
+
+void RawDataModel::update()
+{
+    if (pager.isActive()) {
+        pager.update(eyePosition(), cubeSizes);
+    }
+
+    // the next step swaps in place, nothing else of the volume is rebuilt
+    if (series.isActive() && series.update(asset->textures[0], playTimeSeries, timeSeriesRate)) {
+        timestep = series.getCurrentStep();
+
+        if (onTimestepChanged) onTimestepChanged();
+    }
+
+    // read before the slabs, once finished every slab is already queued
+    VolumeLoader::Stage stage = loader.getStage();
+
+    if (stage == VolumeLoader::Idle) return;
+
+    loadProgress = loader.getProgress() * 100.f;
+    VolumeAsset *pending = loader.pendingAsset();
+    bool slabsUploaded = true;
+
+    if (pending) {
+        if (previewTexture == 0) {
+            // allocate storage only, slabs are filled as they arrive
+            previewTexture = create3DTexture(pending->volume, nullptr);
+            setupGeometry(glm::ivec3(pending->volume.width(), pending->volume.height(), pending->volume.depth()), pending->spacing);
+        }
+
+        slabsUploaded = uploadSlabs(pending->volume);
+    }
+
+    switch (stage) {
+        case VolumeLoader::Finished:
+            // the preview becomes level 0, it has to be complete first
+            if (slabsUploaded) swapVolume();
+
+            break;
+
+        case VolumeLoader::Failed:
+            loader.take();
+            discardPreview();
+            break;
+
+        default:
+            break;
+    }
+}
+
+bool RawDataModel::uploadSlabs(const VolumeData &level)
+{
+    size_t sliceBytes = (size_t)level.width() * level.height() * level.bytesPerVoxel();
+    const unsigned char *voxels = (const unsigned char *)level.data();
+    VolumeStreamer::Slab slab;
+    glBindTexture(GL_TEXTURE_3D, previewTexture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    // the rest waits for the next frames, the ui stays responsive
+    for (int uploads = 0; uploads < MAX_SLAB_UPLOADS_PER_FRAME; uploads++) {
+        if (!loader.popSlab(slab)) return true;
+
+        glTexSubImage3D(GL_TEXTURE_3D, 0, 0, 0, slab.firstCut, level.width(), level.height(), slab.cutCount, GL_RED, level.glType(),
+                        voxels + slab.firstCut * sliceBytes);
+    }
+
+    return !loader.hasSlabs();
+}
+
+void RawDataModel::swapVolume()
+{
+    std::unique_ptr<VolumeAsset> next = loader.take();
+    bool previewed = previewTexture != 0;
+    next->textures.assign(next->pyramid.levelCount(), 0);
+
+    // level 0 was streamed into the preview texture
+    if (previewed) {
+        next->textures[0] = previewTexture;
+        previewTexture = 0;
+    }
+
+    uploadLevels(*next, previewed ? 1 : next->budgetLevel);
+
+    if (!next->gradients.empty()) createGradientTextures(*next);
+
+    // every level is on the gpu before the old volume goes away
+    releaseVolume();
+    asset = std::move(next);
+    occupancyChanged = true;
+    // control points follow the native values, the lut gets one entry per value
+    transferFunction.setMaxIsoValue(asset->volume.type() == VolumeData::UInt8 ? 255 : 65535);
+
+    if (!previewed) setupGeometry(asset->size, asset->spacing);
+
+    if (asset->paged) initPager();
+
+    // cpu reads go through the compressed bricks from now on
+    if (!asset->compressed.empty()) asset->volume.clear();
+
+    // only series of raw or header files whose level 0 fits the budget
+    if (timeSeries && asset->file.isOpen() && asset->budgetLevel == 0 &&
+            series.start(sModelName, width, height, numCuts, glm::vec2(windowLow, windowHigh), asset->histogram)) {
+        timestep = series.getCurrentStep();
+    }
+
+    isLoaded = true;
+    std::cout << "volume texture created" << std::endl;
+
+    if (onVolumeLoaded) onVolumeLoaded();
+}
+
+void RawDataModel::discardPreview()
+{
+    if (previewTexture == 0) return;
+
+    glDeleteTextures(1, &previewTexture);
+    previewTexture = 0;
+
+    // back to the volume that was on screen
+    if (isLoaded) setupGeometry(asset->size, asset->spacing);
+}
+
+void RawDataModel::initPager()
+{
+    GLint maxTextureSize = 0;
+    glGetIntegerv(GL_MAX_3D_TEXTURE_SIZE, &maxTextureSize);
+    size_t budgetBytes = (size_t)std::max(0, gpuBudgetMB) << 20;
+
+    // the brick pool gets what the resident levels leave over
+    for (int l = 0; l < asset->pyramid.levelCount(); l++) {
+        if (asset->textures[l] != 0) budgetBytes -= std::min(budgetBytes, asset->pyramid.level(l).sizeInBytes());
+    }
+
+    pager.init(asset->bricked, budgetBytes, (size_t)std::max(0, cacheBudgetMB) << 20, maxTextureSize);
+}
+
+glm::vec3 RawDataModel::eyePosition() const
+{
+    return glm::vec3(glm::inverse(view * model) * glm::vec4(0.f, 0.f, 0.f, 1.f));
+}
+
+void RawDataModel::setupGeometry(const glm::ivec3 &size, const glm::vec3 &spacing)
+{
+    // bricked and header files carry their own size
+    this->width = size.x;
+    this->height = size.y;
+    this->numCuts = size.z;
+    // physical extent of the volume, voxels may not be cubic
+    glm::vec3 extent = glm::vec3(width, height, numCuts) * spacing;
+    cubeSizes = extent / std::max(std::max(extent.x, extent.y), extent.z);
     // move object to center
     this->transform.scale = cubeSizes;
     this->transform.setPosition(-cubeSizes.x / 2.f, -cubeSizes.y / 2.f, 0.f);
@@ -76,9 +289,6 @@ void RawDataModel::load(const char *pszFilepath, int width, int height, int numC
     this->normalMatrix = glm::inverse(glm::transpose(view * model));
     this->viewProjection = projection * view;
     this->modelViewProjection = this->viewProjection * model;
-    // copy asset location
-    memcpy(sModelName, pszFilepath, 1024);
-    isLoaded = true;
 }
 
 bool RawDataModel::createVertexBuffer()
@@ -140,7 +350,24 @@ bool RawDataModel::createVertexBuffer()
 
 void RawDataModel::render()
 {
-    if (isLoaded) {
+    // the latest published control points, edits made from here on wait
+    // for the next frame
+    stf.update(transferFunction.snapshot());
+
+    if (isLoaded || previewTexture != 0) {
+        // ranges of paged bricks and later series steps aren't in the grid,
+        // previews may belong to another volume
+        skipEmptySpace = emptySpaceSkipping && previewTexture == 0 && !pager.isActive() && !series.isActive() &&
+                         !asset->minMax.empty();
+
+        if (skipEmptySpace) updateOccupancy(renderLevel());
+
+        // a table row per 1 / 255 would smear the features of finer luts,
+        // those are sampled at full resolution instead
+        preIntegrate = preIntegrated && stf.TransferResolution() <= PreIntegrationTable::MAX_SIZE;
+
+        if (preIntegrate) updatePreIntegration();
+
         // render cube back face for exit points
         renderBackFace();
         // render front face and volume with ray casting technique
@@ -150,12 +377,33 @@ void RawDataModel::render()
 
 void RawDataModel::renderCubeFace(GLenum gCullFace)
 {
+    // the proxy isn't convex, exits are at its farthest back face
+    bool farthest = skipEmptySpace && gCullFace == GL_FRONT;
+
+    if (farthest) {
+        glClearDepth(0.0);
+        glDepthFunc(GL_GREATER);
+    }
+
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
     glEnable(GL_CULL_FACE);
     glCullFace(gCullFace);
-    glBindVertexArray(vertexBuffer);
-    glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, (GLuint *)NULL);
+
+    if (!skipEmptySpace) {
+        glBindVertexArray(vertexBuffer);
+        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, (GLuint *)NULL);
+    } else if (!proxy.empty()) {
+        // nothing is drawn when the transfer function hides everything
+        glBindVertexArray(proxyArray);
+        glDrawElements(GL_TRIANGLES, (GLsizei)proxy.getIndices().size(), GL_UNSIGNED_INT, (GLuint *)NULL);
+    }
+
     glDisable(GL_CULL_FACE);
+
+    if (farthest) {
+        glClearDepth(1.0);
+        glDepthFunc(GL_LESS);
+    }
 }
 
 bool RawDataModel::createBackFaceTexture()
@@ -179,88 +427,49 @@ bool RawDataModel::createBackFaceTexture()
     return true;
 }
 
-bool RawDataModel::loadVolumeFromFile8(const char *pszFilepath, int width, int height, int numCuts)
+void RawDataModel::uploadLevels(VolumeAsset &target, int firstLevel)
 {
-    FILE *fp;
-    size_t size = width * height * numCuts;
-
-    if (dataScalars) {
-        delete []dataScalars;
-        dataScalars = nullptr;
-        glDeleteTextures(1, &volumeTexture);
+    for (int l = firstLevel; l < target.pyramid.levelCount(); l++) {
+        const VolumeData &level = target.pyramid.level(l);
+        target.textures[l] = create3DTexture(level, level.data());
     }
-
-    GLubyte *data = new GLubyte[size]; // 8bit
-
-    if (!(fp = fopen(pszFilepath, "rb"))) {
-        std::cout << "Error: opening " << pszFilepath << " file failed: " << std::endl;
-        perror("fopen");
-        return false;
-    } else {
-        std:: cout << "OK: opening " << pszFilepath << " file successed" << std::endl;
-    }
-
-    if (fread(data, sizeof(GLubyte), size, fp) != size) {
-        std::cout << "Error: reading " << pszFilepath << " file failed" << std::endl;
-        fclose(fp);
-        return false;
-    } else {
-        std::cout << "OK: reading " << pszFilepath << " file successed" << std::endl;
-    }
-
-    dataScalars = new float[size];
-
-    for (unsigned int i = 0; i < size; i++) {
-        dataScalars[i] = (float)data[i] / std::numeric_limits<byte>::max();
-    }
-
-    fclose(fp);
-    create3DTexture(width, height, numCuts);
-    std::cout << "volume texture created" << std::endl;
-    return true;
 }
 
-bool RawDataModel::loadVolumeFromFile16(const char *pszFilepath, int width, int height, int numCuts)
+static GLuint createLinearTexture(GLint internalFormat, const glm::ivec3 &size, GLenum format, GLenum type, const void *texels)
 {
-    FILE *fp;
-    size_t size = width * height * numCuts;
-
-    if (dataScalars) {
-        delete[]dataScalars;
-        dataScalars = nullptr;
-    }
-
-    unsigned short *data = new unsigned short[size]; // 16 bits
-
-    if (!(fp = fopen(pszFilepath, "rb"))) {
-        std::cout << "Error: opening " << pszFilepath << " file failed: " << std::endl;
-        perror("fopen");
-        return false;
-    } else {
-        std::cout << "OK: opening " << pszFilepath << " file successed" << std::endl;
-    }
-
-    if (fread(data, sizeof(unsigned short), size, fp) != size) {
-        std::cout << "Error: reading " << pszFilepath << " file failed" << std::endl;
-        fclose(fp);
-        return false;
-    } else {
-        std::cout << "OK: reading " << pszFilepath << " file successed" << std::endl;
-    }
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_3D, texture);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage3D(GL_TEXTURE_3D, 0, internalFormat, size.x, size.y, size.z, 0, format, type, texels);
+    return texture;
+}
 
-    dataScalars = new float[size];
+void RawDataModel::createGradientTextures(VolumeAsset &target)
+{
+    const GradientVolume &gradients = target.gradients;
+    bool wide = gradients.getEncoding() == GradientVolume::Octahedral16;
+    target.gradientTexture = createLinearTexture(wide ? GL_RG16_SNORM : GL_RG8_SNORM, gradients.getSize(), GL_RG,
+                             wide ? GL_SHORT : GL_BYTE, gradients.directionData());
+    target.gradientMagnitudeTexture = createLinearTexture(GL_R8, gradients.getSize(), GL_RED, GL_UNSIGNED_BYTE,
+                                      gradients.magnitudeData());
+}
 
-    for (unsigned int i = 0; i < size; i++) {
-        dataScalars[i] = (float)data[i] / std::numeric_limits<unsigned short>::max();
-    }
+int RawDataModel::renderLevel() const
+{
+    // coarser levels hold the first step only
+    if (series.isActive()) return 0;
 
-    fclose(fp);
-    create3DTexture(width, height, numCuts);
-    std::cout << "volume texture created" << std::endl;
-    return true;
+    // coarser level while the user drags the volume around
+    int level = asset->budgetLevel + (interacting ? interactionLevelBias : 0);
+    return std::min(level, (int)asset->textures.size() - 1);
 }
 
-
 bool RawDataModel::createFrameBuffer()
 {
     if (frameBuffer > 0) return true;
@@ -297,17 +506,88 @@ void RawDataModel::createTransferFunctionTexture()
     glTexImage1D(GL_TEXTURE_1D, 0, GL_RGBA8, 256, 0, GL_RGBA, GL_FLOAT, transferFunc);
 }
 
-void RawDataModel::updateTransferFunctionTexture()
+void RawDataModel::updateOccupancy(int level)
 {
-    //TransferFunction::getLinearFunction(this->transferFunc);
-    //glBindTexture(GL_TEXTURE_1D, transferFunctionTexture);
-    //glTexImage1D(GL_TEXTURE_1D, 0, GL_RGBA8, 256, 0, GL_RGBA, GL_FLOAT, transferFunc);
-    stf.updateIndexFunctionTexture();
-    stf.updateTransferFunctionTexture();
+    // a coarse sample averages voxels of neighbour cells, footprint twice its size
+    int dilation = level == 0 ? 0 : ((2 << level) + asset->minMax.getCellSize() - 1) / asset->minMax.getCellSize();
+
+    if (!occupancyChanged && dilation == occupancyDilation && stf.BakeCount() == occupancyBake) return;
+
+    occupancyChanged = false;
+    occupancyDilation = dilation;
+    occupancyBake = stf.BakeCount();
+    std::vector<float> opacity(stf.TransferResolution());
+
+    for (int i = 0; i < opacity.size(); i++) opacity[i] = stf.transferTexture[i].y;
+
+    occupancy.build(asset->minMax, &opacity[0], (int)opacity.size(), dilation);
+
+    if (occupancyTexture == 0) {
+        glGenTextures(1, &occupancyTexture);
+        glBindTexture(GL_TEXTURE_3D, occupancyTexture);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    }
+
+    const glm::ivec3 &size = occupancy.getSize();
+    glBindTexture(GL_TEXTURE_3D, occupancyTexture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage3D(GL_TEXTURE_3D, 0, GL_R8, size.x, size.y, size.z, 0, GL_RED, GL_UNSIGNED_BYTE, occupancy.data());
+    proxy.build(occupancy, glm::vec3((float)asset->minMax.getCellSize()) / glm::vec3(asset->size));
+    uploadProxy();
 }
 
-void RawDataModel::create3DTexture(int width, int height, int numCuts)
+void RawDataModel::updatePreIntegration()
 {
+    if (stf.BakeCount() == preIntegrationBake && stepSize == preIntegrationStep && preIntegrationTexture != 0) return;
+
+    preIntegrationBake = stf.BakeCount();
+    preIntegrationStep = stepSize;
+    preIntegration.build(&stf.transferTexture[0], stf.TransferResolution(), stepSize);
+
+    if (preIntegrationTexture == 0) {
+        glGenTextures(1, &preIntegrationTexture);
+        glBindTexture(GL_TEXTURE_2D, preIntegrationTexture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    }
+
+    glBindTexture(GL_TEXTURE_2D, preIntegrationTexture);
+    // 16 bits keep the small opacities of short steps
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RG16, preIntegration.getSize(), preIntegration.getSize(), 0, GL_RG, GL_FLOAT, preIntegration.data());
+}
+
+void RawDataModel::uploadProxy()
+{
+    if (proxyArray == 0) {
+        glGenBuffers(2, proxyBuffers);
+        glGenVertexArrays(1, &proxyArray);
+        glBindVertexArray(proxyArray);
+        glEnableVertexAttribArray(0);
+        glEnableVertexAttribArray(1);
+        // positions double as entry and exit colors, like the unit cube
+        glBindBuffer(GL_ARRAY_BUFFER, proxyBuffers[0]);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (GLfloat *)NULL);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, (GLfloat *)NULL);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, proxyBuffers[1]);
+    }
+
+    const std::vector<glm::vec3> &vertices = proxy.getVertices();
+    const std::vector<unsigned int> &indices = proxy.getIndices();
+    glBindVertexArray(proxyArray);
+    glBindBuffer(GL_ARRAY_BUFFER, proxyBuffers[0]);
+    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(glm::vec3), vertices.empty() ? NULL : &vertices[0], GL_STATIC_DRAW);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), indices.empty() ? NULL : &indices[0], GL_STATIC_DRAW);
+}
+
+GLuint RawDataModel::create3DTexture(const VolumeData &level, const void *voxels)
+{
+    GLuint volumeTexture;
     glGenTextures(1, &volumeTexture);
     glBindTexture(GL_TEXTURE_3D, volumeTexture);							// bind 3D texture target
     glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
@@ -315,7 +595,11 @@ void RawDataModel::create3DTexture(int width, int height, int numCuts)
     glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP);
     glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP);
     glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP);
-    glTexImage3D(GL_TEXTURE_3D, 0, GL_INTENSITY, width, height, numCuts, 0, GL_LUMINANCE, GL_FLOAT, dataScalars);
+    // rows of 8 bit volumes aren't necessarily 4 byte aligned
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage3D(GL_TEXTURE_3D, 0, level.glInternalFormat(), level.width(), level.height(), level.depth(), 0, GL_RED, level.glType(),
+                 voxels);
+    return volumeTexture;
 }
 
 void RawDataModel::setupVolumeShaders()
@@ -346,6 +630,22 @@ void RawDataModel::setupVolumeShaders()
     this->rayCastShader.addUniform("ViewMatrix");
     this->rayCastShader.addUniform("ScreenSize");
     this->rayCastShader.addUniform("NormalMatrix");
+    this->rayCastShader.addUniform("Paged");
+    this->rayCastShader.addUniform("PageTable");
+    this->rayCastShader.addUniform("BrickPool");
+    this->rayCastShader.addUniform("PageGridSize");
+    this->rayCastShader.addUniform("PoolSize");
+    this->rayCastShader.addUniform("BrickSize");
+    this->rayCastShader.addUniform("VolumeSize");
+    this->rayCastShader.addUniform("UseGradientTexture");
+    this->rayCastShader.addUniform("GradientTex");
+    this->rayCastShader.addUniform("GradientMagnitudeTex");
+    this->rayCastShader.addUniform("GradientSize");
+    this->rayCastShader.addUniform("UseOccupancy");
+    this->rayCastShader.addUniform("OccupancyTex");
+    this->rayCastShader.addUniform("OccupancyCellSize");
+    this->rayCastShader.addUniform("PreIntegrated");
+    this->rayCastShader.addUniform("PreIntegrationTex");
 }
 
 void RawDataModel::renderVolumeRayCasting()
@@ -361,7 +661,7 @@ void RawDataModel::renderVolumeRayCasting()
     this->rayCastShader.setUniform("ScreenSize", (float)MainData::rootWindow->getSize().x, (float)MainData::rootWindow->getSize().y);
     // style transfer function
     glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_1D, this->stf.transferFunctionTexture);
+    glBindTexture(GL_TEXTURE_2D, this->stf.transferFunctionTexture);
     this->rayCastShader.setUniform("transferFunctionTexture", 1);
     glActiveTexture(GL_TEXTURE2);
     glBindTexture(GL_TEXTURE_1D, this->stf.indexFunctionTexture);
@@ -373,9 +673,58 @@ void RawDataModel::renderVolumeRayCasting()
     glActiveTexture(GL_TEXTURE4);
     glBindTexture(GL_TEXTURE_2D, this->backFaceTexture);
     this->rayCastShader.setUniform("ExitPoints", 4);
+    int level = renderLevel();
     glActiveTexture(GL_TEXTURE5);
-    glBindTexture(GL_TEXTURE_3D, this->volumeTexture);
+    glBindTexture(GL_TEXTURE_3D, previewTexture != 0 ? previewTexture : asset->textures[level]);
     this->rayCastShader.setUniform("VolumeTex", 5);
+    // paged volumes sample the brick pool, the level above is the fallback
+    bool paged = previewTexture == 0 && pager.isActive();
+    this->rayCastShader.setUniform("Paged", paged ? 1 : 0);
+
+    if (paged) {
+        glActiveTexture(GL_TEXTURE6);
+        glBindTexture(GL_TEXTURE_3D, pager.getPageTableTexture());
+        this->rayCastShader.setUniform("PageTable", 6);
+        glActiveTexture(GL_TEXTURE7);
+        glBindTexture(GL_TEXTURE_3D, pager.getPoolTexture());
+        this->rayCastShader.setUniform("BrickPool", 7);
+        this->rayCastShader.setUniform("PageGridSize", glm::vec3(pager.getGridSize()));
+        this->rayCastShader.setUniform("PoolSize", glm::vec3(pager.getPoolSize()));
+        this->rayCastShader.setUniform("BrickSize", (float)pager.getBrickSize());
+        this->rayCastShader.setUniform("VolumeSize", glm::vec3(asset->size));
+    }
+
+    // precomputed gradients describe the first step of a series only
+    bool gradientTexture = useGradientTexture && previewTexture == 0 && asset->gradientTexture != 0 && !series.isActive();
+    this->rayCastShader.setUniform("UseGradientTexture", gradientTexture ? 1 : 0);
+
+    if (gradientTexture) {
+        glActiveTexture(GL_TEXTURE8);
+        glBindTexture(GL_TEXTURE_3D, asset->gradientTexture);
+        this->rayCastShader.setUniform("GradientTex", 8);
+        glActiveTexture(GL_TEXTURE9);
+        glBindTexture(GL_TEXTURE_3D, asset->gradientMagnitudeTexture);
+        this->rayCastShader.setUniform("GradientMagnitudeTex", 9);
+        this->rayCastShader.setUniform("GradientSize", glm::vec3(asset->gradients.getSize()));
+    }
+
+    this->rayCastShader.setUniform("PreIntegrated", preIntegrate ? 1 : 0);
+
+    if (preIntegrate) {
+        glActiveTexture(GL_TEXTURE11);
+        glBindTexture(GL_TEXTURE_2D, preIntegrationTexture);
+        this->rayCastShader.setUniform("PreIntegrationTex", 11);
+    }
+
+    this->rayCastShader.setUniform("UseOccupancy", skipEmptySpace ? 1 : 0);
+
+    if (skipEmptySpace) {
+        glActiveTexture(GL_TEXTURE10);
+        glBindTexture(GL_TEXTURE_3D, occupancyTexture);
+        this->rayCastShader.setUniform("OccupancyTex", 10);
+        this->rayCastShader.setUniform("OccupancyCellSize", glm::vec3((float)asset->minMax.getCellSize()) / glm::vec3(asset->size));
+    }
+
     //glActiveTexture(GL_TEXTURE6);
     //glBindTexture(GL_TEXTURE_1D, this->transferFunctionTexture);
     //this->rayCastShader.setUniform("TransferFunc", 6);
@@ -390,88 +739,3 @@ void RawDataModel::renderBackFace()
     this->backFaceShader.setUniform("MVP", this->modelViewProjection);
     renderCubeFace(GL_FRONT);
 }
-
-void RawDataModel::generateGradients(int sampleSize)
-{
-    int n = sampleSize;
-    glm::vec3 normal = glm::vec3(0.f);
-    glm::vec3 s1, s2;
-    int index = 0;
-
-    for (int z = 0; z < numCuts; z++) {
-        for (int y = 0; y < height; y++) {
-            for (int x = 0; x < width; x++) {
-                s1 = glm::vec3(sampleVolume(x - n, y, z),
-                               sampleVolume(x, y - n, z),
-                               sampleVolume(x, y, z - n));
-                s2 = glm::vec3(sampleVolume(x + n, y, z),
-                               sampleVolume(x, y + n, z),
-                               sampleVolume(x, y, z + n));
-                gradients[index++] = glm::normalize(s2 - s1);
-
-                if (std::isnan(gradients[index - 1].x)) {
-                    gradients[index - 1] = glm::vec3(0.f);
-                }
-            }
-        }
-    }
-}
-
-float RawDataModel::sampleVolume(int x, int y, int z)
-{
-    x = (int)glm::clamp(x, 0, width - 1);
-    y = (int)glm::clamp(y, 0, height - 1);
-    y = (int)glm::clamp(z, 0, numCuts - 1);
-    return (float)dataScalars[x + (y * width) + (z * width * height)];
-}
-
-void RawDataModel::filterNxNxN(int sampleSize)
-{
-    int index = 0;
-
-    for (int z = 0; z < numCuts; z++) {
-        for (int y = 0; y < height; y++) {
-            for (int x = 0; x < width; x++) {
-                gradients[index++] = sampleNxNxN(x, y, z, sampleSize);
-            }
-        }
-    }
-}
-
-glm::vec3 &RawDataModel::sampleNxNxN(int x, int y, int z, int n)
-{
-    n = (n - 1) / 2;
-    glm::vec3 average = glm::vec3(0.f);
-    int num = 0;
-
-    for (int k = z - n; k <= z + n; k++) {
-        for (int j = y - n; j <= y + n; j++) {
-            for (int i = x - n; i <= x + n; i++) {
-                if (isInBounds(i, j, k)) {
-                    average += sampleGradients(i, j, k);
-                    num++;
-                }
-            }
-        }
-    }
-
-    average /= (float)num;
-
-    if (average.x != 0.0f && average.y != 0.0f && average.z != 0.0f) {
-        glm::normalize(average);
-    }
-
-    return average;
-}
-
-bool RawDataModel::isInBounds(int x, int y, int z)
-{
-    return ((x >= 0 && x < width) &&
-            (y >= 0 && y < height) &&
-            (z >= 0 && z < numCuts));
-}
-
-glm::vec3 &RawDataModel::sampleGradients(int x, int y, int z)
-{
-    return gradients[x + (y * width) + (z * width * height)];
-}
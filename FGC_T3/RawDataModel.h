@@ -4,43 +4,92 @@
 #include "MainData.h"
 #include "ShaderProgram.h"
 #include "StyleTransfer.h"
+#include "VolumeLoader.h"
+#include "BrickPager.h"
+#include "TimeSeries.h"
+#include "OccupancyGrid.h"
+#include "ProxyGeometry.h"
+#include "PreIntegrationTable.h"
 
 class RawDataModel {
     private:
+        // streamed slabs on the gpu per frame, larger volumes show up over
+        // more frames instead of freezing one
+        static const int MAX_SLAB_UPLOADS_PER_FRAME = 4;
+
         GLuint backFaceTexture;
         GLuint depthRenderBuffer;
         GLuint frameBuffer;
         GLuint vertexBuffer;
         GLuint transferFunctionTexture;
-        GLuint volumeTexture;
         int _heightP;
         int _numCutsP;
         int _widthP;
+        // volume on screen, never null, empty until the first load
+        std::unique_ptr<VolumeAsset> asset;
+        VolumeLoader loader;
+        // level 0 of the loading volume, filled slab by slab
+        GLuint previewTexture;
+        // full resolution bricks of paged assets
+        BrickPager pager;
+        // later steps of a numbered series, played through level 0
+        TimeSeries series;
+        // cells of asset->minMax visible under the current opacity
+        OccupancyGrid occupancy;
+        GLuint occupancyTexture;
+        // set when a volume is swapped in, the grid is rebuilt on the next frame
+        bool occupancyChanged;
+        // what the grid was built for, see StyleTransfer::BakeCount
+        unsigned int occupancyBake;
+        int occupancyDilation;
+        // visible bricks drawn instead of the unit cube for ray entry and exit
+        ProxyGeometry proxy;
+        GLuint proxyArray;
+        GLuint proxyBuffers[2];
+        // occupancy and proxy are in use this frame
+        bool skipEmptySpace;
+        // the pre-integration table is in use this frame
+        bool preIntegrate;
+        // segment classification for the current transfer function and step
+        PreIntegrationTable preIntegration;
+        GLuint preIntegrationTexture;
+        unsigned int preIntegrationBake;
+        float preIntegrationStep;
 
         bool createBackFaceTexture();
         bool createFrameBuffer();
         bool createVertexBuffer();
-        bool loadVolumeFromFile16(const char *pszFilepath, int width, int height, int numCuts);
-        bool loadVolumeFromFile8(const char *pszFilepath, int width, int height, int numCuts);
-        void create3DTexture(int width, int height, int numCuts);
+        GLuint create3DTexture(const VolumeData &level, const void *voxels);
+        // at most MAX_SLAB_UPLOADS_PER_FRAME, true once none are left
+        bool uploadSlabs(const VolumeData &level);
+        void uploadLevels(VolumeAsset &target, int firstLevel);
+        void createGradientTextures(VolumeAsset &target);
+        // rebuilds the occupancy texture if the opacity or level changed
+        void updateOccupancy(int level);
+        void uploadProxy();
+        // rebuilds the table if the transfer function or step size changed
+        void updatePreIntegration();
+        void swapVolume();
+        void discardPreview();
+        void setupGeometry(const glm::ivec3 &size, const glm::vec3 &spacing);
+        void initPager();
+        // camera position in normalized volume coordinates
+        glm::vec3 eyePosition() const;
+        int renderLevel() const;
+        void releaseVolume();
         void createTransferFunctionTexture();
         void renderBackFace();
         void renderCubeFace(GLenum gCullFace);
         void renderVolumeRayCasting();
         void setupVolumeShaders();
-        void generateGradients(int sampleSize);
-        void filterNxNxN(int sampleSize);
-        glm::vec3 &sampleNxNxN(int x, int y, int z, int n);
-        float sampleVolume(int x, int y, int z);
-        glm::vec3 &sampleGradients(int x, int y, int z);
-        bool isInBounds(int x, int y, int z);
 
     public:
-        float *dataScalars;
-        glm::vec3 *gradients;
         glm::vec4 transferFunc[256];
 
         StyleTransfer stf;
+        // edited from the ui and the editing window, baked into the stf
+        // textures at the start of every frame
+        TransferFunction transferFunction;
 
         // cube face width height depth
         glm::vec3 cubeSizes;
@@ -63,16 +112,85 @@ class RawDataModel {
         char *sModelName;
         float stepSize;
         float threshold;
+        // gpu memory for the volume textures, applied on load
+        int gpuBudgetMB;
+        // normalized value window applied on load, [0, 1] keeps the data as is
+        float windowLow;
+        float windowHigh;
+        // page the finest level of bricked files instead of loading it
+        bool pagedBricks;
+        // ram for paged bricks read ahead of the gpu
+        int cacheBudgetMB;
+        // keep the cpu copy compressed once the volume is on the gpu
+        bool compressCpuCopy;
+        // gradients of the rendered level, built on load
+        bool precomputeGradients;
+        // GradientVolume::Operator and Encoding, ints for the ui
+        int gradientOperator;
+        int gradientEncoding;
+        // shade from the gradient texture instead of finite differences
+        bool useGradientTexture;
+        // leap over macro cells the transfer function leaves transparent
+        bool emptySpaceSkipping;
+        // classify segments between samples instead of single samples, for
+        // luts up to PreIntegrationTable::MAX_SIZE entries
+        bool preIntegrated;
+        // smoothing radius in voxels applied on load, 0 disables it
+        int smoothRadius;
+        bool gaussianSmoothing;
+        // smooth the voxels too, otherwise only the gradients
+        bool smoothScalars;
+        // extra levels dropped while interacting
+        int interactionLevelBias;
+        bool interacting;
+        // percentage of the running load, shown in the ui
+        float loadProgress;
+        // called on the render thread once a loaded volume is swapped in
+        std::function<void()> onVolumeLoaded;
+        // play numbered files next to the loaded one as timesteps
+        bool timeSeries;
+        bool playTimeSeries;
+        float timeSeriesRate;
+        // step on screen, shown in the ui
+        int timestep;
+        // called on the render thread after playback moved to another step
+        std::function<void()> onTimestepChanged;
 
         int height;
         int numCuts;
         int width;
 
+        // starts loading in the background, the current volume stays on
+        // screen until the new one can be previewed
         void load(const char *pszFilepath, int width, int height, int numCuts);
+        // gl side of the background load, called once per frame
+        void update();
         void render();
+        // empty when the cpu copy is kept compressed
+        const VolumeData &getVolume() const
+        {
+            return asset->volume;
+        }
+        const CompressedVolume &getCompressedVolume() const
+        {
+            return asset->compressed;
+        }
+        bool isPaged() const
+        {
+            return asset->paged;
+        }
+        // histogram of the step on screen while a series plays
+        const std::array<unsigned int, 256> &getHistogram() const
+        {
+            return series.isActive() ? series.getHistogram() : asset->histogram;
+        }
+        // value by gradient magnitude counts, of the first step of a series
+        const JointHistogram &getJointHistogram() const
+        {
+            return asset->jointHistogram;
+        }
 
         RawDataModel(void);
         ~RawDataModel(void);
-        void updateTransferFunctionTexture();
 };
 
@@ -16,19 +16,86 @@ uniform float     StepSize = 0.01f;
 uniform float     Threshold = 0.15f;
 uniform vec2      ScreenSize;
 
-// style transfer function uniforms
-uniform sampler1D transferFunctionTexture;
+// paged bricks, see BrickPager
+uniform bool       Paged = false;
+uniform usampler3D PageTable;
+uniform sampler3D  BrickPool;
+uniform vec3       PageGridSize;
+uniform vec3       PoolSize;
+uniform float      BrickSize;
+uniform vec3       VolumeSize;
+
+// precomputed gradients, see GradientVolume
+uniform bool      UseGradientTexture = false;
+// octahedral direction as rg snorm, magnitude as r8
+uniform sampler3D GradientTex;
+uniform sampler3D GradientMagnitudeTex;
+uniform vec3      GradientSize;
+
+// macro cells left transparent by the transfer function, see OccupancyGrid
+uniform bool      UseOccupancy = false;
+uniform sampler3D OccupancyTex;
+uniform vec3      OccupancyCellSize;
+
+// style index and opacity of the segment between two samples, indexed by
+// front and back value, see PreIntegrationTable. indices are fetched from
+// the nearest entry, a filtered one would blend unrelated styles
+uniform bool      PreIntegrated = false;
+uniform sampler2D PreIntegrationTex;
+
+// style transfer function uniforms, the index and opacity lut is wrapped in
+// rows of 256 entries
+uniform sampler2D transferFunctionTexture;
 uniform sampler1D indexFunctionTexture;
 uniform sampler2DArray styleTransferTexture;
 
 layout(location = 0) out vec4 FragColor;
 
+float sampleVolume(vec3 P)
+{
+  if (!Paged) return texture(VolumeTex, P).x;
+
+  // voxel space, brick slots carry a one voxel border
+  vec3 voxel = clamp(P, 0.f, 1.f) * VolumeSize;
+  vec3 brick = min(floor(voxel / BrickSize), PageGridSize - 1.f);
+  uvec4 entry = texelFetch(PageTable, ivec3(brick), 0);
+
+  // not paged in yet, the resident coarse level stands in
+  if (entry.w == 0u) return texture(VolumeTex, P).x;
+
+  vec3 poolVoxel = vec3(entry.xyz) * (BrickSize + 2.f) + 1.f + voxel - brick * BrickSize;
+  return texture(BrickPool, poolVoxel / PoolSize).x;
+}
+
+vec2 transferFunction(float value)
+{
+  ivec2 size = textureSize(transferFunctionTexture, 0);
+  int entry = int(clamp(value, 0.f, 1.f) * float(size.x * size.y - 1) + 0.5f);
+  return texelFetch(transferFunctionTexture, ivec2(entry % size.x, entry / size.x), 0).xy;
+}
+
+vec3 octahedralDecode(vec2 e)
+{
+  vec3 n = vec3(e, 1.f - abs(e.x) - abs(e.y));
+  // unfolds the lower hemisphere
+  float t = max(-n.z, 0.f);
+  n.xy += mix(vec2(t), vec2(-t), greaterThanEqual(n.xy, vec2(0.f)));
+  return normalize(n);
+}
+
 vec3 computeGradient(vec3 P, float lookUp)
 {
+  if (UseGradientTexture) {
+    vec3 direction = octahedralDecode(texture(GradientTex, P).xy);
+    float magnitude = texture(GradientMagnitudeTex, P).x;
+    // per voxel derivative to the forward difference over StepSize below
+    return direction * magnitude * GradientSize * StepSize;
+  }
+
   float L = StepSize;
-  float E = texture(VolumeTex, P + vec3(L,0,0));
-  float N = texture(VolumeTex, P + vec3(0,L,0));
-  float U = texture(VolumeTex, P + vec3(0,0,L));
+  float E = sampleVolume(P + vec3(L,0,0));
+  float N = sampleVolume(P + vec3(0,L,0));
+  float U = sampleVolume(P + vec3(0,0,L));
   return vec3(E - lookUp, N - lookUp, U - lookUp);
 }
 
@@ -81,15 +148,47 @@ void main()
   vec4 baseColor = vec4(0.f);
   vec4 src = vec4(0.f);
 
+  // per axis distance along the ray to cross one unit, axis parallel rays never do
+  vec3 rayUnit = rayDirection / rayLength;
+  vec3 inverseDirection = 1.f / mix(rayUnit, vec3(1e-6f), lessThan(abs(rayUnit), vec3(1e-6f)));
+
+  // none after the start and every leap, the segment then starts at the sample
+  float previousDensity = -1.f;
+
   while(dst.a < 1.f && rayLength > 0.f) {
-    float density = texture(VolumeTex, pos).x;
+    if (UseOccupancy) {
+      ivec3 cell = clamp(ivec3(floor(pos / OccupancyCellSize)), ivec3(0), textureSize(OccupancyTex, 0) - 1);
+
+      if (texelFetch(OccupancyTex, cell, 0).x == 0.f) {
+        // whole steps up to the first sample past the cell keep the jitter
+        vec3 cellExit = (vec3(cell) + step(0.f, rayUnit)) * OccupancyCellSize;
+        vec3 distances = (cellExit - pos) * inverseDirection;
+        float steps = max(ceil(min(distances.x, min(distances.y, distances.z)) / StepSize), 1.f);
+        pos += stepVector * steps;
+        rayLength -= StepSize * steps;
+        previousDensity = -1.f;
+        continue;
+      }
+    }
+
+    float density = sampleVolume(pos);
 
     #ifdef USE_THRESHOLD
       if(density > Threshold) {
     #endif
 
-    float opacity = texture(transferFunctionTexture, density).g;
-    float index = texture(transferFunctionTexture, density).r;
+    vec2 entry = transferFunction(density);
+    float opacity = entry.g;
+    float index = entry.r;
+
+    if (PreIntegrated) {
+      // texel centers hold the values 0, 1 / 255 ... 1
+      vec2 values = vec2(density, previousDensity < 0.f ? density : previousDensity);
+      index = texelFetch(PreIntegrationTex, ivec2(values * 255.f + 0.5f), 0).x;
+      opacity = texture(PreIntegrationTex, (values * 255.f + 0.5f) / 256.f).y;
+    }
+
+    previousDensity = density;
     int styleIndex = int(texture(indexFunctionTexture, index).x * AVAILABLE_STYLE_COUNT);
     vec3 previousNormal = normal;
 
@@ -0,0 +1,124 @@
+#include "SplineSampler.h"
+#include "VoxelConverter.h"
+#include <emmintrin.h>
+
+SplineSampler::SplineSampler(void)
+{
+    count = 0;
+}
+
+SplineSampler::~SplineSampler(void)
+{
+}
+
+bool SplineSampler::set(const double *x, const double *y, int count, bool cubic)
+{
+    if (count < 1 || count > MAX_POINTS) return false;
+
+    for (int i = 0; i < count - 1; i++) {
+        if (!(x[i] < x[i + 1])) return false;
+    }
+
+    this->count = count;
+    std::copy(x, x + count, this->x);
+    std::copy(y, y + count, this->y);
+    std::fill(a, a + count, 0.0);
+    std::fill(b, b + count, 0.0);
+    std::fill(c, c + count, 0.0);
+
+    if (count == 1) return true;
+
+    if (cubic && count > 2) {
+        // tridiagonal system for the curvatures b, zero at both ends. a
+        // holds the eliminated upper diagonal, c the eliminated right side
+        a[0] = 0.0;
+        c[0] = 0.0;
+
+        for (int i = 1; i < count - 1; i++) {
+            double lower = (x[i] - x[i - 1]) / 3.0;
+            double diagonal = 2.0 * (x[i + 1] - x[i - 1]) / 3.0;
+            double upper = (x[i + 1] - x[i]) / 3.0;
+            double rhs = (y[i + 1] - y[i]) / (x[i + 1] - x[i]) - (y[i] - y[i - 1]) / (x[i] - x[i - 1]);
+            double pivot = diagonal - lower * a[i - 1];
+            a[i] = upper / pivot;
+            c[i] = (rhs - lower * c[i - 1]) / pivot;
+        }
+
+        b[count - 1] = 0.0;
+
+        for (int i = count - 2; i >= 1; i--) b[i] = c[i] - a[i] * b[i + 1];
+
+        b[0] = 0.0;
+
+        for (int i = 0; i < count - 1; i++) {
+            double h = x[i + 1] - x[i];
+            a[i] = (b[i + 1] - b[i]) / (3.0 * h);
+            c[i] = (y[i + 1] - y[i]) / h - (2.0 * b[i] + b[i + 1]) * h / 3.0;
+        }
+    } else {
+        for (int i = 0; i < count - 1; i++) c[i] = (y[i + 1] - y[i]) / (x[i + 1] - x[i]);
+    }
+
+    // past the last point the curve keeps the slope and curvature it ends with
+    double h = x[count - 1] - x[count - 2];
+    a[count - 1] = 0.0;
+    c[count - 1] = 3.0 * a[count - 2] * h * h + 2.0 * b[count - 2] * h + c[count - 2];
+    return true;
+}
+
+double SplineSampler::operator()(double value) const
+{
+    int i = (int)(std::upper_bound(x, x + count, value) - x) - 1;
+
+    // left of the first point the curve is extended by a parabola
+    if (i < 0) return (b[0] * (value - x[0]) + c[0]) * (value - x[0]) + y[0];
+
+    double h = value - x[i];
+    return ((a[i] * h + b[i]) * h + c[i]) * h + y[i];
+}
+
+// samples [first, last) of one segment, h runs from h0 in steps of step
+static void sampleSegment(double a, double b, double c, double y, double h0, double step, int first, int last, float *dst, size_t stride,
+                          bool simd)
+{
+    int k = first;
+
+    if (simd) {
+        __m128 va = _mm_set1_ps((float)a), vb = _mm_set1_ps((float)b), vc = _mm_set1_ps((float)c), vy = _mm_set1_ps((float)y);
+        __m128 offsets = _mm_mul_ps(_mm_set_ps(3.f, 2.f, 1.f, 0.f), _mm_set1_ps((float)step));
+
+        for (; k + 4 <= last; k += 4) {
+            __m128 h = _mm_add_ps(_mm_set1_ps((float)(h0 + (k - first) * step)), offsets);
+            __m128 value = _mm_add_ps(_mm_mul_ps(_mm_add_ps(_mm_mul_ps(_mm_add_ps(_mm_mul_ps(va, h), vb), h), vc), h), vy);
+            float values[4];
+            _mm_storeu_ps(values, value);
+
+            for (int j = 0; j < 4; j++) dst[(k + j) * stride] = values[j];
+        }
+    }
+
+    for (; k < last; k++) {
+        double h = h0 + (k - first) * step;
+        dst[k * stride] = (float)(((a * h + b) * h + c) * h + y);
+    }
+}
+
+void SplineSampler::sample(double first, double step, int samples, float *dst, size_t stride, bool simd) const
+{
+    if (count == 0) return;
+
+    simd = simd && VoxelConverter::detectIsa() >= VoxelConverter::SSE2;
+    int k = std::min(samples, std::max(0, (int)std::ceil((x[0] - first) / step)));
+    // left of the first point the curve is extended by a parabola
+    sampleSegment(0.0, b[0], c[0], y[0], first - x[0], step, 0, k, dst, stride, simd);
+
+    // the segments are walked once, each one takes the samples up to the next point
+    for (int i = 0; i < count && k < samples; i++) {
+        int end = samples;
+
+        if (i + 1 < count) end = std::min(samples, std::max(k, (int)std::ceil((x[i + 1] - first) / step)));
+
+        sampleSegment(a[i], b[i], c[i], y[i], first + k * step - x[i], step, k, end, dst, stride, simd);
+        k = end;
+    }
+}
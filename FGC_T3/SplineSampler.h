@@ -0,0 +1,33 @@
+#pragma once
+#include "Commons.h"
+
+// linear or natural cubic interpolation of control points, sampled into
+// lookup tables. coefficients live in fixed arrays and cubic ones are
+// solved with the thomas algorithm, so neither set nor sample allocates.
+// samples are evaluated segment by segment, four at a time with sse2
+class SplineSampler {
+    public:
+        static const int MAX_POINTS = 512;
+
+    private:
+        int count;
+        // f(x) = ((a * h + b) * h + c) * h + y with h = x - x[i]
+        double x[MAX_POINTS];
+        double y[MAX_POINTS];
+        double a[MAX_POINTS];
+        double b[MAX_POINTS];
+        double c[MAX_POINTS];
+
+        SplineSampler(const SplineSampler &);
+        SplineSampler &operator=(const SplineSampler &);
+    public:
+        // false without points, with more than MAX_POINTS or with x not
+        // strictly increasing
+        bool set(const double *x, const double *y, int count, bool cubic);
+        double operator()(double value) const;
+        // dst[k * stride] = f(first + k * step) for k in [0, samples)
+        void sample(double first, double step, int samples, float *dst, size_t stride = 1, bool simd = true) const;
+
+        SplineSampler(void);
+        ~SplineSampler(void);
+};
@@ -1,11 +1,13 @@
 #include "StyleTransfer.h"
 #include "FreeImage.h"
-#include "TransferFunction.h"
 
 StyleTransfer::StyleTransfer() : stylesLoaded(false)
 {
+    bakeCount = 0;
+
+    for (int i = 0; i < AVAILABLE_STYLE_COUNT; i++) availableStyles[i] = bakedStyles[i] = 0;
+
     // call this ONLY when linking with FreeImage as a static library
-    for (int i = 0; i < AVAILABLE_STYLE_COUNT; i++) availableStyles[i] = 0;
 
     #ifdef FREEIMAGE_LIB
     FreeImage_Initialise();
@@ -20,10 +22,11 @@ StyleTransfer::~StyleTransfer()
 void StyleTransfer::createTransferFunctionTexture()
 {
     glGenTextures(1, &transferFunctionTexture);
-    glBindTexture(GL_TEXTURE_1D, transferFunctionTexture);
-    glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D, transferFunctionTexture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 }
 
 void StyleTransfer::createStyleFunctionTexture()
@@ -92,29 +95,85 @@ void StyleTransfer::createIndexFunctionTexture()
     glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 }
 
-void StyleTransfer::updateIndexFunctionTexture()
+void StyleTransfer::updateIndexFunctionTexture(size_t controlPointCount)
 {
     glBindTexture(GL_TEXTURE_1D, indexFunctionTexture);
-    indexFunction = new float[TransferFunction::getControlPoints().size()];
+    indexFunction.resize(controlPointCount);
 
-    for (int i = 0; i < TransferFunction::getControlPoints().size(); i++) {
-        indexFunction[i] = (float)availableStyles[i] / (AVAILABLE_STYLE_COUNT - 1);
+    // points past the last style slot get the default one
+    for (int i = 0; i < indexFunction.size(); i++) {
+        indexFunction[i] = i < AVAILABLE_STYLE_COUNT ? (float)availableStyles[i] / (AVAILABLE_STYLE_COUNT - 1) : 0.f;
     }
 
-    glTexImage1D(GL_TEXTURE_1D, 0, GL_INTENSITY, TransferFunction::getControlPoints().size(), 0, GL_LUMINANCE, GL_FLOAT, indexFunction);
+    glTexImage1D(GL_TEXTURE_1D, 0, GL_INTENSITY, (GLsizei)indexFunction.size(), 0, GL_LUMINANCE, GL_FLOAT, indexFunction.data());
 }
 
-void StyleTransfer::updateTransferFunctionTexture()
+// red carries the style index, the shared points keep their own colors
+static std::vector<ControlPoint> indexedControlPoints(const std::vector<ControlPoint> &controlPoints)
 {
-    int controlPointsSize = TransferFunction::getControlPoints().size();
+    std::vector<ControlPoint> indexed(controlPoints);
+    int controlPointsSize = indexed.size();
 
     for (int i = 0; i < controlPointsSize; i++) {
-        TransferFunction::getControlPointColors(i)[0] = (float)i / (controlPointsSize - 1);
+        indexed[i].rgba[0] = (float)i / (controlPointsSize - 1);
+    }
+
+    return indexed;
+}
+
+void StyleTransfer::updateTransferFunctionTexture(const TransferFunction::Snapshot &snapshot)
+{
+    int resolution = TransferFunction::resolutionFor(snapshot.maxIsoValue);
+    transferTexture.assign(resolution, glm::vec2(0.f));
+    TransferFunction::getLinearFunction(indexedControlPoints(snapshot.controlPoints), snapshot.maxIsoValue, resolution, 0, resolution,
+                                        &transferTexture[0]);
+    glBindTexture(GL_TEXTURE_2D, transferFunctionTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RG16, TRANSFER_TEXTURE_WIDTH, resolution / TRANSFER_TEXTURE_WIDTH, 0, GL_RG, GL_FLOAT,
+                 &transferTexture[0]);
+}
+
+void StyleTransfer::updateTransferFunctionRange(const TransferFunction::Snapshot &snapshot, int low, int high)
+{
+    int resolution = (int)transferTexture.size();
+    double texelsPerIso = (double)(resolution - 1) / snapshot.maxIsoValue;
+    // whole rows, the texels at both ends included
+    int firstRow = (int)(low * texelsPerIso) / TRANSFER_TEXTURE_WIDTH;
+    int lastRow = std::min((int)std::ceil(high * texelsPerIso), resolution - 1) / TRANSFER_TEXTURE_WIDTH;
+    int first = firstRow * TRANSFER_TEXTURE_WIDTH;
+    int count = (lastRow - firstRow + 1) * TRANSFER_TEXTURE_WIDTH;
+    TransferFunction::getLinearFunction(indexedControlPoints(snapshot.controlPoints), snapshot.maxIsoValue, resolution, first, count,
+                                        &transferTexture[first]);
+    glBindTexture(GL_TEXTURE_2D, transferFunctionTexture);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, firstRow, TRANSFER_TEXTURE_WIDTH, lastRow - firstRow + 1, GL_RG, GL_FLOAT,
+                    &transferTexture[first]);
+}
+
+void StyleTransfer::update(const std::shared_ptr<const TransferFunction::Snapshot> &snapshot)
+{
+    bool pointsChanged = !baked || snapshot->epoch != baked->epoch;
+    // styles are edited in place by the ui
+    bool stylesChanged = !std::equal(availableStyles, availableStyles + AVAILABLE_STYLE_COUNT, bakedStyles);
+
+    int low, high;
+
+    if (pointsChanged && baked && TransferFunction::changedRange(*baked, *snapshot, low, high)) {
+        // a point moved or recolored, the count and range are the same
+        if (low <= high) {
+            updateTransferFunctionRange(*snapshot, low, high);
+            bakeCount++;
+        }
+    } else if (pointsChanged) {
+        updateTransferFunctionTexture(*snapshot);
+        bakeCount++;
     }
 
-    TransferFunction::getLinearFunction(this->transferTexture);
-    glBindTexture(GL_TEXTURE_1D, transferFunctionTexture);
-    glTexImage1D(GL_TEXTURE_1D, 0, GL_RG8, 256, 0, GL_RG, GL_FLOAT, this->transferTexture);
+    // moves keep the count, the index texture only follows count and styles
+    bool countChanged = !baked || snapshot->controlPoints.size() != baked->controlPoints.size();
+
+    if (countChanged || stylesChanged) updateIndexFunctionTexture(snapshot->controlPoints.size());
+
+    baked = snapshot;
+    std::copy(availableStyles, availableStyles + AVAILABLE_STYLE_COUNT, bakedStyles);
 }
 
 void StyleTransfer::loadStyles()
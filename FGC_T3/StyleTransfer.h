@@ -1,14 +1,18 @@
 #pragma once
 #include "Commons.h"
+#include "TransferFunction.h"
 
 class StyleTransfer {
 
     public:
         static const unsigned int AVAILABLE_STYLE_COUNT = 34;
+        static const int TRANSFER_TEXTURE_WIDTH = 256;
 
         BYTE *wholeData;
         static const std::string styleTextList;
-        glm::vec2 transferTexture[256];
+        // style index and opacity per lut entry, TRANSFER_TEXTURE_WIDTH
+        // entries a row so the largest luts fit in a texture
+        std::vector<glm::vec2> transferTexture;
 
         bool stylesLoaded;
         unsigned int transferFunctionTexture;
@@ -19,15 +23,35 @@ class StyleTransfer {
         void createTransferFunctionTexture();
         void createStyleFunctionTexture();
 
+        // what the textures were last baked from
+        std::shared_ptr<const TransferFunction::Snapshot> baked;
+        unsigned int bakedStyles[AVAILABLE_STYLE_COUNT];
+        unsigned int bakeCount;
+
     public:
         unsigned int availableStyles[AVAILABLE_STYLE_COUNT];
-        float *indexFunction;
+        std::vector<float> indexFunction;
         StyleTransfer();
         ~StyleTransfer();
         void loadStyles();
 
-        void updateIndexFunctionTexture();
-        void updateTransferFunctionTexture();
+        void updateIndexFunctionTexture(size_t controlPointCount);
+        void updateTransferFunctionTexture(const TransferFunction::Snapshot &snapshot);
+        // resamples and uploads only the rows holding iso values low to high
+        void updateTransferFunctionRange(const TransferFunction::Snapshot &snapshot, int low, int high);
+        // rebakes only what the control points or styles changed since the
+        // last call, render thread only
+        void update(const std::shared_ptr<const TransferFunction::Snapshot> &snapshot);
+
+        int TransferResolution() const
+        {
+            return (int)transferTexture.size();
+        }
+        // changes whenever transferTexture is rebaked
+        unsigned int BakeCount() const
+        {
+            return bakeCount;
+        }
 
         bool StylesLoaded() const
         {
@@ -0,0 +1,258 @@
+#include "TimeSeries.h"
+#include "MappedFile.h"
+#include "Parallel.h"
+#include "VoxelConverter.h"
+#include "VolumeLoader.h"
+
+TimeSeries::TimeSeries(void) : stopping(false)
+{
+    window = glm::vec2(0.f, 1.f);
+    range = glm::vec2(0.f, 1.f);
+    backTexture = 0;
+    backStep = -1;
+    currentStep = 0;
+    histogram.fill(0);
+    backHistogram.fill(0);
+}
+
+TimeSeries::~TimeSeries(void)
+{
+    stop();
+}
+
+std::vector<std::string> TimeSeries::listTimesteps(const char *pszFilepath)
+{
+    std::vector<std::string> steps;
+    std::string path(pszFilepath);
+    size_t slash = path.find_last_of("\\/");
+    std::string directory = slash == std::string::npos ? "" : path.substr(0, slash + 1);
+    std::string name = path.substr(directory.size());
+    // the last digit run of the name is the step number
+    size_t digitsEnd = name.find_last_of("0123456789");
+
+    if (digitsEnd == std::string::npos) return steps;
+
+    size_t digitsBegin = name.find_last_not_of("0123456789", digitsEnd);
+    digitsBegin = digitsBegin == std::string::npos ? 0 : digitsBegin + 1;
+    std::string prefix = name.substr(0, digitsBegin);
+    std::string suffix = name.substr(digitsEnd + 1);
+    std::vector<std::pair<unsigned long long, std::string>> numbered;
+    WIN32_FIND_DATA findData;
+    HANDLE find = FindFirstFile((directory + prefix + "*" + suffix).c_str(), &findData);
+
+    if (find == INVALID_HANDLE_VALUE) return steps;
+
+    do {
+        std::string candidate = findData.cFileName;
+
+        if (!(findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) && candidate.size() > prefix.size() + suffix.size()) {
+            std::string digits = candidate.substr(prefix.size(), candidate.size() - prefix.size() - suffix.size());
+
+            if (digits.size() < 20 && digits.find_first_not_of("0123456789") == std::string::npos) {
+                numbered.push_back(std::make_pair(std::stoull(digits), candidate));
+            }
+        }
+    } while (FindNextFile(find, &findData));
+
+    FindClose(find);
+
+    if (numbered.size() < 2) return steps;
+
+    std::sort(numbered.begin(), numbered.end());
+
+    for (auto &step : numbered) steps.push_back(directory + step.second);
+
+    return steps;
+}
+
+bool TimeSeries::start(const char *pszFilepath, int width, int height, int numCuts, const glm::vec2 &window,
+                       const std::array<unsigned int, 256> &firstHistogram, int ringSize)
+{
+    stop();
+    std::vector<std::string> steps = listTimesteps(pszFilepath);
+
+    if (steps.empty()) return false;
+
+    if (VolumeHeader::isHeaderFile(pszFilepath)) {
+        if (!layout.load(pszFilepath)) return false;
+    } else {
+        layout = VolumeHeader::fromRaw(pszFilepath, width, height, numCuts, VolumeData::UInt8);
+    }
+
+    files = steps;
+    this->window = window;
+    auto first = std::find(files.begin(), files.end(), std::string(pszFilepath));
+    currentStep = first == files.end() ? 0 : (int)(first - files.begin());
+    histogram = firstHistogram;
+    backStep = -1;
+    // every staging volume is allocated once, steps are converted in place
+    ringSize = std::max(1, std::min(ringSize, (int)files.size() - 1));
+    freeSlots.reset(new BoundedQueue<int>(ringSize));
+    readySlots.reset(new BoundedQueue<int>(ringSize));
+
+    for (int i = 0; i < ringSize; i++) {
+        ring.push_back(std::unique_ptr<Staging>(new Staging()));
+        ring.back()->volume.allocate(layout.type, layout.width, layout.height, layout.depth);
+        freeSlots->push(i);
+    }
+
+    glGenTextures(1, &backTexture);
+    glBindTexture(GL_TEXTURE_3D, backTexture);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP);
+    glTexImage3D(GL_TEXTURE_3D, 0, VolumeData::glInternalFormat(layout.type), layout.width, layout.height, layout.depth, 0, GL_RED,
+                 VolumeData::glType(layout.type), nullptr);
+    lastSwap = std::chrono::steady_clock::now();
+    stopping = false;
+    prefetcher = std::thread(&TimeSeries::prefetchLoop, this, (currentStep + 1) % (int)files.size());
+    std::cout << "OK: time series of " << files.size() << " steps" << std::endl;
+    return true;
+}
+
+void TimeSeries::stop()
+{
+    if (!isActive()) return;
+
+    stopping = true;
+    freeSlots->close();
+    readySlots->close();
+
+    if (prefetcher.joinable()) prefetcher.join();
+
+    glDeleteTextures(1, &backTexture);
+    backTexture = 0;
+    backStep = -1;
+    ring.clear();
+    files.clear();
+}
+
+bool TimeSeries::update(GLuint &frontTexture, bool playing, float stepsPerSecond)
+{
+    if (!isActive()) return false;
+
+    int slot;
+
+    // the next step goes up ahead of its turn, at most one per frame
+    if (backStep < 0 && readySlots->tryPop(slot)) {
+        const Staging &staged = *ring[slot];
+        glBindTexture(GL_TEXTURE_3D, backTexture);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTexSubImage3D(GL_TEXTURE_3D, 0, 0, 0, 0, layout.width, layout.height, layout.depth, GL_RED, staged.volume.glType(),
+                        staged.volume.data());
+        backStep = staged.step;
+        backHistogram = staged.histogram;
+        freeSlots->push(slot);
+    }
+
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    std::chrono::duration<float> period(1.f / std::max(stepsPerSecond, 0.01f));
+
+    if (!playing || backStep < 0 || now - lastSwap < period) return false;
+
+    std::swap(frontTexture, backTexture);
+    currentStep = backStep;
+    histogram = backHistogram;
+    backStep = -1;
+    lastSwap = now;
+    return true;
+}
+
+void TimeSeries::prefetchLoop(int firstStep)
+{
+    int stepCount = (int)files.size();
+    int step = firstStep;
+    int slot;
+
+    // every step shares the value range of the first one
+    if (layout.type == VolumeData::Float32) {
+        VolumeHeader header;
+        MappedFile file;
+
+        if (readHeader(files[currentStep], header) && file.open(header.dataFile.c_str()) &&
+                file.size() >= header.dataOffset + header.dataSize()) {
+            range = VoxelConverter::floatRange(file.data() + header.dataOffset, (size_t)header.width * header.height * header.depth,
+                                               header.bigEndian);
+        }
+    }
+
+    while (!stopping && freeSlots->pop(slot)) {
+        int failures = 0;
+
+        // unreadable steps are skipped, playback ends if none can be read
+        while (!stopping && !readStep(step, *ring[slot])) {
+            step = (step + 1) % stepCount;
+
+            if (++failures == stepCount) return;
+        }
+
+        readySlots->push(slot);
+        step = (step + 1) % stepCount;
+    }
+}
+
+bool TimeSeries::readHeader(const std::string &path, VolumeHeader &header) const
+{
+    if (VolumeHeader::isHeaderFile(path.c_str())) {
+        if (!header.load(path.c_str())) return false;
+    } else {
+        header = VolumeHeader::fromRaw(path.c_str(), layout.width, layout.height, layout.depth, layout.type);
+    }
+
+    if (header.width != layout.width || header.height != layout.height || header.depth != layout.depth || header.type != layout.type) {
+        std::cout << "Error: timestep " << path << " doesn't match the layout of the first step" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+bool TimeSeries::readStep(int step, Staging &target) const
+{
+    VolumeHeader header;
+    MappedFile file;
+
+    if (!readHeader(files[step], header) || !file.open(header.dataFile.c_str())) return false;
+
+    if (file.size() < header.dataOffset + header.dataSize()) {
+        std::cout << "Error: reading " << header.dataFile << " file failed, expected " << header.dataSize() << " bytes" << std::endl;
+        return false;
+    }
+
+    const unsigned char *source = file.data() + header.dataOffset;
+    VolumeData &volume = target.volume;
+    size_t sliceSize = (size_t)header.width * header.height;
+    size_t sliceBytes = sliceSize * volume.bytesPerVoxel();
+    bool needsConversion = header.needsConversion() || !VoxelConverter::isIdentityWindow(window);
+    VoxelConverter::Params conversion = VoxelConverter::makeParams(header.type, header.isSigned,
+                                        header.bigEndian && header.type != VolumeData::UInt8, range, window);
+    std::mutex histogramMutex;
+    target.histogram.fill(0);
+    parallelFor(0, header.depth, [&](int firstCut, int lastCut) {
+        std::array<unsigned int, 256> local;
+        local.fill(0);
+
+        // each slab is counted right after converting it, while still in cache
+        for (int z = firstCut; z < lastCut; z += SLAB_CUTS) {
+            int cuts = std::min(lastCut - z, SLAB_CUTS);
+            size_t offset = z * sliceBytes;
+            unsigned char *dst = (unsigned char *)volume.mutableData() + offset;
+
+            if (needsConversion) {
+                VoxelConverter::convert(conversion, source + offset, dst, cuts * sliceSize);
+            } else {
+                memcpy(dst, source + offset, cuts * sliceBytes);
+            }
+
+            VolumeLoader::accumulateHistogram(volume, z * sliceSize, cuts * sliceSize, local);
+        }
+
+        std::lock_guard<std::mutex> lock(histogramMutex);
+
+        for (int i = 0; i < 256; i++) target.histogram[i] += local[i];
+    });
+    target.step = step;
+    return true;
+}
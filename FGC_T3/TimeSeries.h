@@ -0,0 +1,84 @@
+#pragma once
+#include "Commons.h"
+#include "VolumeData.h"
+#include "VolumeHeader.h"
+#include "BoundedQueue.h"
+
+// plays a numbered series of volume files back as timesteps. a prefetch
+// thread reads and converts the steps ahead of the one on screen into a
+// ring of staging volumes, the render thread uploads the next ready one
+// into a back texture before it is due so a swap never waits on disk
+class TimeSeries {
+    private:
+        struct Staging {
+            VolumeData volume;
+            std::array<unsigned int, 256> histogram;
+            int step;
+        };
+
+        std::vector<std::string> files;
+        // layout every step must share with the first one
+        VolumeHeader layout;
+        glm::vec2 window;
+        // raw float range of the first step, shared by every step
+        glm::vec2 range;
+        // staging ring, slot indices move between the free and ready queues
+        std::vector<std::unique_ptr<Staging>> ring;
+        std::unique_ptr<BoundedQueue<int>> freeSlots;
+        std::unique_ptr<BoundedQueue<int>> readySlots;
+        std::thread prefetcher;
+        std::atomic<bool> stopping;
+        // uploaded step waiting for its turn, -1 while empty
+        GLuint backTexture;
+        int backStep;
+        std::array<unsigned int, 256> backHistogram;
+        int currentStep;
+        std::array<unsigned int, 256> histogram;
+        std::chrono::steady_clock::time_point lastSwap;
+
+        // z slices converted and counted at once by a prefetch worker
+        static const int SLAB_CUTS = 4;
+
+        void prefetchLoop(int firstStep);
+        bool readStep(int step, Staging &target) const;
+        bool readHeader(const std::string &path, VolumeHeader &header) const;
+
+        TimeSeries(const TimeSeries &);
+        TimeSeries &operator=(const TimeSeries &);
+    public:
+        static const int DEFAULT_RING_SIZE = 3;
+
+        // files numbered like pszFilepath in its directory, in step order.
+        // empty when there is no other step next to it
+        static std::vector<std::string> listTimesteps(const char *pszFilepath);
+
+        // pszFilepath is step 0, already loaded with the given layout and
+        // histogram. width height and numCuts describe headerless .raw steps
+        bool start(const char *pszFilepath, int width, int height, int numCuts, const glm::vec2 &window,
+                   const std::array<unsigned int, 256> &firstHistogram, int ringSize = DEFAULT_RING_SIZE);
+        void stop();
+        // uploads the next ready step and, when playing and due at the given
+        // rate, swaps it with frontTexture. true when the step changed
+        bool update(GLuint &frontTexture, bool playing, float stepsPerSecond);
+
+        bool isActive() const
+        {
+            return !files.empty();
+        }
+        int getStepCount() const
+        {
+            return (int)files.size();
+        }
+        int getCurrentStep() const
+        {
+            return currentStep;
+        }
+        const std::array<unsigned int, 256> &getHistogram() const
+        {
+            return histogram;
+        }
+
+        TimeSeries(void);
+        ~TimeSeries(void);
+};
+
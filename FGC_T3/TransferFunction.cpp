@@ -1,6 +1,5 @@
 #include "TransferFunction.h"
 
-std::vector<ControlPoint> TransferFunction::controlPoints;
 
 void ControlPoint::create(int r, int g, int b, int alpha, int isovalue)
 {
@@ -11,8 +10,24 @@ void ControlPoint::create(int r, int g, int b, int alpha, int isovalue)
     this->isoValue = isovalue;
 }
 
-void TransferFunction::addControlPoint(int r, int g, int b, int alpha, int isovalue)
+int TransferFunction::resolutionFor(int maxIsoValue)
+{
+    int resolution = MIN_RESOLUTION;
+
+    while (resolution < MAX_RESOLUTION && resolution <= maxIsoValue) resolution <<= 1;
+
+    return resolution;
+}
+
+bool TransferFunction::insertControlPoint(std::vector<ControlPoint> &controlPoints, int maxIsoValue, int r, int g, int b, int alpha,
+        int isovalue)
 {
+    // the sampler holds no more, later points would silently be dropped
+    if ((int)controlPoints.size() >= SplineSampler::MAX_POINTS) {
+        std::cout << "Error: transfer functions hold at most " << SplineSampler::MAX_POINTS << " control points" << std::endl;
+        return false;
+    }
+
     if (alpha < 0) {
         alpha = 0;
     }
@@ -25,8 +40,8 @@ void TransferFunction::addControlPoint(int r, int g, int b, int alpha, int isova
         alpha = 255;
     }
 
-    if (isovalue > 255) {
-        isovalue = 255;
+    if (isovalue > maxIsoValue) {
+        isovalue = maxIsoValue;
     }
 
     ControlPoint nControlPoint;
@@ -67,81 +82,187 @@ void TransferFunction::addControlPoint(int r, int g, int b, int alpha, int isova
     }
 
     controlPoints.insert(it, nControlPoint);
+    return true;
 }
 
-void TransferFunction::getSmoothFunction(glm::vec4 *dst[256])
+void TransferFunction::rescale(std::vector<ControlPoint> &controlPoints, int fromMaxIsoValue, int toMaxIsoValue)
 {
-    // TODO
-}
-
-void TransferFunction::getLinearFunction(glm::vec4 dst[256])
-{
-    std::vector<double> channel[5];
-    tk::Spline channelSpline[4];
+    if (fromMaxIsoValue == toMaxIsoValue || controlPoints.empty()) return;
 
-    // Control Points
-    for (int i = 0; i < controlPoints.size(); i++) {
-        channel[0].push_back(controlPoints[i].rgba[0]);
-        channel[1].push_back(controlPoints[i].rgba[1]);
-        channel[2].push_back(controlPoints[i].rgba[2]);
-        channel[3].push_back(controlPoints[i].rgba[3]);
-        channel[4].push_back(controlPoints[i].isoValue);
+    for (ControlPoint &point : controlPoints) {
+        point.isoValue = (int)((double)point.isoValue * toMaxIsoValue / fromMaxIsoValue + 0.5);
     }
 
-    for (int i = 0; i < 4; i++) {
-        // channelSplineThread(channelSpline[i], channel[4], &channel[i], dst);
-        channelSpline[i].set_points(channel[4], channel[i], false);
-        double min = std::numeric_limits<double>::infinity(), max = 0, current = 0;
-        channel[i].clear();
-
-        for (int k = 0; k < 256; k++) {
-            current = channelSpline[i](k);
-            // Max Min Value
-            max = current > max ? current : max;
-            min = current < min ? current : min;
-            channel[i].push_back(current);
+    // more points than iso values, the ones landing on a kept point merge
+    // into it, the last point keeps the end of the range
+    if (controlPoints.size() > (size_t)toMaxIsoValue + 1) {
+        size_t before = controlPoints.size();
+        std::vector<ControlPoint> merged(1, controlPoints.front());
+
+        for (size_t i = 1; i < controlPoints.size(); i++) {
+            if (controlPoints[i].isoValue != merged.back().isoValue) {
+                merged.push_back(controlPoints[i]);
+            } else if (i == controlPoints.size() - 1 && merged.size() > 1) {
+                merged.back() = controlPoints[i];
+            }
         }
+
+        controlPoints.swap(merged);
+        std::cout << "Error: " << before - controlPoints.size() << " control points merged rescaling to " << toMaxIsoValue << std::endl;
     }
 
-    for (int i = 0; i < 256; i++) {
-        dst[i] = glm::vec4(channel[0][i], channel[1][i], channel[2][i], channel[3][i]);
+    // points merged by a smaller range are pushed apart again
+    for (size_t i = 1; i < controlPoints.size(); i++) {
+        controlPoints[i].isoValue = std::max(controlPoints[i].isoValue, controlPoints[i - 1].isoValue + 1);
     }
+
+    controlPoints.back().isoValue = std::min(controlPoints.back().isoValue, toMaxIsoValue);
+
+    for (size_t i = controlPoints.size() - 1; i > 0; i--) {
+        controlPoints[i - 1].isoValue = std::max(std::min(controlPoints[i - 1].isoValue, controlPoints[i].isoValue - 1), 0);
+    }
+}
+
+static bool operator==(const ControlPoint &a, const ControlPoint &b)
+{
+    return a.isoValue == b.isoValue && std::equal(a.rgba, a.rgba + 4, b.rgba);
 }
 
-void TransferFunction::getLinearFunction(glm::vec2 dst[256])
+bool TransferFunction::changedRange(const Snapshot &before, const Snapshot &after, int &low, int &high)
 {
-    std::vector<double> channel[3];
-    tk::Spline channelSpline[2];
+    const std::vector<ControlPoint> &a = before.controlPoints, &b = after.controlPoints;
+
+    // baked style indices depend on the point count
+    if (a.size() != b.size() || before.maxIsoValue != after.maxIsoValue || b.empty()) return false;
+
+    int first = 0, last = (int)b.size() - 1;
+
+    while (first <= last && a[first] == b[first]) first++;
+
+    while (last >= first && a[last] == b[last]) last--;
 
-    // Control Points
-    for (int i = 0; i < controlPoints.size(); i++) {
-        channel[0].push_back(controlPoints[i].rgba[0]);
-        channel[1].push_back(controlPoints[i].rgba[3]);
-        channel[2].push_back(controlPoints[i].isoValue);
+    if (first > last) {
+        low = 0;
+        high = -1;
+        return true;
     }
 
-    for (int i = 0; i < 2; i++) {
-        channelSpline[i].set_points(channel[2], channel[i], false);
-        channel[i].clear();
+    // the unchanged neighbours bound every segment that changed, the ends
+    // extend to the whole range
+    low = first > 0 ? b[first - 1].isoValue : 0;
+    high = last + 1 < (int)b.size() ? b[last + 1].isoValue : after.maxIsoValue;
+    return true;
+}
 
-        for (int k = 0; k < 256; k++) {
-            channel[i].push_back(channelSpline[i](k));
-        }
+// samples channel of every control point linearly into count entries of a
+// resolution entries lut starting at first, one entry every stride floats
+static void sampleChannel(const std::vector<ControlPoint> &controlPoints, int channel, int maxIsoValue, int resolution, int first,
+                          int count, float *dst, size_t stride)
+{
+    int pointCount = std::min((int)controlPoints.size(), SplineSampler::MAX_POINTS);
+    double isoValues[SplineSampler::MAX_POINTS], values[SplineSampler::MAX_POINTS];
+    SplineSampler spline;
+
+    for (int i = 0; i < pointCount; i++) {
+        isoValues[i] = controlPoints[i].isoValue;
+        values[i] = controlPoints[i].rgba[channel];
     }
 
-    for (int i = 0; i < 256; i++) {
-        dst[i] = glm::vec2(channel[0][i], channel[1][i]);
+    // entries already in dst are kept
+    if (!spline.set(isoValues, values, pointCount, false)) {
+        std::cout << "Error: control points out of order, lut left unchanged" << std::endl;
+        return;
     }
+
+    double step = (double)maxIsoValue / (resolution - 1);
+    spline.sample(first * step, step, count, dst, stride);
+}
+
+void TransferFunction::getLinearFunction(const std::vector<ControlPoint> &controlPoints, int maxIsoValue, int resolution, int first,
+        int count, glm::vec4 *dst)
+{
+    for (int i = 0; i < 4; i++) sampleChannel(controlPoints, i, maxIsoValue, resolution, first, count, &dst[0][i], 4);
+}
+
+void TransferFunction::getLinearFunction(const std::vector<ControlPoint> &controlPoints, int maxIsoValue, int resolution, int first,
+        int count, glm::vec2 *dst)
+{
+    sampleChannel(controlPoints, 0, maxIsoValue, resolution, first, count, &dst[0].x, 2);
+    sampleChannel(controlPoints, 3, maxIsoValue, resolution, first, count, &dst[0].y, 2);
+}
+
+TransferFunction::TransferFunction(void)
+{
+    epoch = 0;
+    maxIsoValue = 255;
+    std::lock_guard<std::mutex> lock(editMutex);
+    publish();
+}
+
+TransferFunction::~TransferFunction(void)
+{
+}
+
+void TransferFunction::publish()
+{
+    std::shared_ptr<Snapshot> next(new Snapshot());
+    next->controlPoints = controlPoints;
+    next->maxIsoValue = maxIsoValue;
+    next->epoch = ++epoch;
+    std::atomic_store(&published, std::shared_ptr<const Snapshot>(next));
 }
 
-void TransferFunction::deleteAlphaControlPoint(unsigned const int index)
+void TransferFunction::addControlPoint(int r, int g, int b, int alpha, int isovalue)
 {
+    std::lock_guard<std::mutex> lock(editMutex);
+    if (insertControlPoint(controlPoints, maxIsoValue, r, g, b, alpha, isovalue)) publish();
+}
+
+void TransferFunction::deleteControlPoint(unsigned int index)
+{
+    std::lock_guard<std::mutex> lock(editMutex);
+
+    if (index >= controlPoints.size()) return;
+
     controlPoints.erase(controlPoints.begin() + index);
+    publish();
 }
 
-float *TransferFunction::getControlPointColors(unsigned const int index)
+void TransferFunction::moveControlPoint(unsigned int index, int alpha, int isovalue)
 {
-    return controlPoints[index].rgba;
+    std::lock_guard<std::mutex> lock(editMutex);
+
+    if (index >= controlPoints.size()) return;
+
+    ControlPoint moved = controlPoints[index];
+    std::vector<ControlPoint> result(controlPoints);
+    result.erase(result.begin() + index);
+    insertControlPoint(result, maxIsoValue, (int)(moved.rgba[0] * 255 + 0.5f), (int)(moved.rgba[1] * 255 + 0.5f), (int)(moved.rgba[2] * 255 + 0.5f), alpha, isovalue);
+
+    // held still while dragging, readers keep the current epoch
+    if (result == controlPoints) return;
+
+    controlPoints.swap(result);
+    publish();
+}
+
+void TransferFunction::assign(const std::vector<ControlPoint> &controlPoints, int maxIsoValue)
+{
+    std::lock_guard<std::mutex> lock(editMutex);
+    this->controlPoints = controlPoints;
+    rescale(this->controlPoints, maxIsoValue, this->maxIsoValue);
+    publish();
+}
+
+void TransferFunction::setMaxIsoValue(int maxIsoValue)
+{
+    std::lock_guard<std::mutex> lock(editMutex);
+
+    if (maxIsoValue == this->maxIsoValue) return;
+
+    rescale(controlPoints, this->maxIsoValue, maxIsoValue);
+    this->maxIsoValue = maxIsoValue;
+    publish();
 }
 
 bool operator<(ControlPoint const &a, ControlPoint const &b)
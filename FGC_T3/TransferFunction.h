@@ -1,6 +1,6 @@
-#pragma
+#pragma once
 #include "commons.h"
-#include "Spline.h"
+#include "SplineSampler.h"
 
 class ControlPoint {
     public:
@@ -11,30 +11,70 @@ class ControlPoint {
         friend bool operator<(ControlPoint const &a, ControlPoint const &b);
 };
 
+// control points edited by the ui and the editing window. every edit
+// publishes an immutable snapshot, readers take the latest one without
+// locking and keep it as long as they need, i.e the render thread once a
+// frame to bake its textures. iso values are in native data units, from 0
+// up to the largest value of the voxel type
 class TransferFunction {
-    private:
-        static std::vector<ControlPoint> controlPoints;
     public:
-        static void addControlPoint(int r, int g, int b, int alpha, int isovalue);
-        static void deleteAlphaControlPoint(unsigned const int index);
-        static void getSmoothFunction(glm::vec4 *dst[256]);
-        static void getLinearFunction(glm::vec4 dst[256]);
-        static void getLinearFunction(glm::vec2 dst[256]);
-        static float *getControlPointColors(unsigned const int index);
-
-        static const ControlPoint &getControlPoint(unsigned const int index)
-        {
-            return controlPoints[index];
+        struct Snapshot {
+            std::vector<ControlPoint> controlPoints;
+            int maxIsoValue;
+            // increases with every edit
+            unsigned int epoch;
         };
 
-        static const std::vector<ControlPoint> &getControlPoints()
-        {
-            return controlPoints;
-        }
+    private:
+        // edits from several threads are applied one after the other
+        std::mutex editMutex;
+        std::vector<ControlPoint> controlPoints;
+        int maxIsoValue;
+        unsigned int epoch;
+        std::shared_ptr<const Snapshot> published;
+
+        // editMutex has to be held
+        void publish();
 
-        static void Clear()
+        TransferFunction(const TransferFunction &);
+        TransferFunction &operator=(const TransferFunction &);
+    public:
+        static const int MIN_RESOLUTION = 256;
+        static const int MAX_RESOLUTION = 65536;
+
+        // lut entries for iso values up to maxIsoValue, a power of two
+        static int resolutionFor(int maxIsoValue);
+        // inserts keeping the iso values sorted, unique and up to maxIsoValue.
+        // false once the curve has SplineSampler::MAX_POINTS points
+        static bool insertControlPoint(std::vector<ControlPoint> &controlPoints, int maxIsoValue, int r, int g, int b, int alpha,
+                                       int isovalue);
+        // iso values scaled from one maximum to another, still unique
+        static void rescale(std::vector<ControlPoint> &controlPoints, int fromMaxIsoValue, int toMaxIsoValue);
+        // entries first to first + count of a resolution entries lut, the
+        // first entry is iso value 0 and the last maxIsoValue
+        static void getLinearFunction(const std::vector<ControlPoint> &controlPoints, int maxIsoValue, int resolution, int first,
+                                      int count, glm::vec4 *dst);
+        static void getLinearFunction(const std::vector<ControlPoint> &controlPoints, int maxIsoValue, int resolution, int first,
+                                      int count, glm::vec2 *dst);
+        // iso values low to high enclose every change of the linear function
+        // between both, false if the whole function has to be sampled again
+        static bool changedRange(const Snapshot &before, const Snapshot &after, int &low, int &high);
+
+        void addControlPoint(int r, int g, int b, int alpha, int isovalue);
+        void deleteControlPoint(unsigned int index);
+        // delete and insert again as one edit, readers never see the point missing
+        void moveControlPoint(unsigned int index, int alpha, int isovalue);
+        // every point at once, i.e loaded from a file with iso values up to
+        // maxIsoValue
+        void assign(const std::vector<ControlPoint> &controlPoints, int maxIsoValue);
+        // on volume changes, the points keep their place relative to the range
+        void setMaxIsoValue(int maxIsoValue);
+
+        std::shared_ptr<const Snapshot> snapshot() const
         {
-            controlPoints.clear();
+            return std::atomic_load(&published);
         }
 
-};
\ No newline at end of file
+        TransferFunction(void);
+        ~TransferFunction(void);
+};
@@ -145,7 +145,7 @@ void TW_CALL fileDialogButtonOnCB(void *clientData)
             // use the contents of szFile to initialize itself.
             ofn.lpstrFile[0] = '\0';
             ofn.nMaxFile = sizeof(szFile);
-            ofn.lpstrFilter = "RAW\0*.raw\0";
+            ofn.lpstrFilter = "Volume\0*.raw;*.bvol;*.nrrd;*.nhdr;*.mhd;*.mha;*.png;*.tif;*.tiff;*.bmp\0";
             ofn.nFilterIndex = 1;
             ofn.lpstrFileTitle = NULL;
             ofn.nMaxFileTitle = 0;
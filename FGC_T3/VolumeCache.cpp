@@ -0,0 +1,237 @@
+#include "VolumeCache.h"
+
+const char *VolumeCache::DIRECTORY = "cache";
+
+static const unsigned long long FNV_OFFSET = 14695981039346656037ULL;
+static const unsigned long long FNV_PRIME = 1099511628211ULL;
+// header and trailer blocks plus SAMPLE_COUNT strided ones in between
+static const size_t EDGE_BLOCK = 1 << 16;
+static const size_t SAMPLE_BLOCK = 1 << 12;
+static const size_t SAMPLE_COUNT = 64;
+
+static unsigned long long fnv1a(const unsigned char *data, size_t size, unsigned long long value)
+{
+    for (size_t i = 0; i < size; i++) {
+        value = (value ^ data[i]) * FNV_PRIME;
+    }
+
+    return value;
+}
+
+VolumeCache::VolumeCache(void)
+{
+    sections = nullptr;
+    sectionCount = 0;
+}
+
+VolumeCache::~VolumeCache(void)
+{
+    close();
+}
+
+unsigned long long VolumeCache::hash(const unsigned char *data, size_t size)
+{
+    unsigned long long value = fnv1a((const unsigned char *)&size, sizeof(size), FNV_OFFSET);
+
+    if (size <= 2 * EDGE_BLOCK + SAMPLE_COUNT * SAMPLE_BLOCK) return fnv1a(data, size, value);
+
+    value = fnv1a(data, EDGE_BLOCK, value);
+    size_t stride = (size - 2 * EDGE_BLOCK) / SAMPLE_COUNT;
+
+    for (size_t i = 0; i < SAMPLE_COUNT; i++) {
+        value = fnv1a(data + EDGE_BLOCK + i * stride, SAMPLE_BLOCK, value);
+    }
+
+    return fnv1a(data + size - EDGE_BLOCK, EDGE_BLOCK, value);
+}
+
+std::string VolumeCache::keyFor(const std::string &path, const unsigned char *data, size_t size, const std::string &parameters)
+{
+    char fullPath[MAX_PATH] = {};
+    WIN32_FILE_ATTRIBUTE_DATA attributes = {};
+
+    if (!GetFullPathName(path.c_str(), MAX_PATH, fullPath, NULL)) strncpy(fullPath, path.c_str(), MAX_PATH - 1);
+
+    GetFileAttributesEx(fullPath, GetFileExInfoStandard, &attributes);
+    std::stringstream versioned;
+    // a rewritten file gets a new write time, samples catch in place edits
+    // that kept it
+    versioned << "v" << VERSION << " " << fullPath << " " << attributes.ftLastWriteTime.dwHighDateTime << " "
+              << attributes.ftLastWriteTime.dwLowDateTime << " " << parameters;
+    std::string tag = versioned.str();
+    unsigned long long value = fnv1a((const unsigned char *)tag.c_str(), tag.size(), hash(data, size));
+    char key[17];
+    sprintf(key, "%016llx", value);
+    return key;
+}
+
+std::string VolumeCache::pathFor(const std::string &key)
+{
+    return std::string(DIRECTORY) + "\\" + key + ".vcache";
+}
+
+bool VolumeCache::open(const std::string &key)
+{
+    close();
+    std::string path = pathFor(key);
+
+    // a miss is the common case, no error is printed
+    if (GetFileAttributes(path.c_str()) == INVALID_FILE_ATTRIBUTES || !file.open(path.c_str())) return false;
+
+    Header header;
+
+    if (file.size() >= sizeof(Header)) memcpy(&header, file.data(), sizeof(Header));
+
+    if (file.size() < sizeof(Header) || header.magic != MAGIC || header.version != VERSION ||
+            file.size() < sizeof(Header) + header.sectionCount * sizeof(Section)) {
+        std::cout << "Error: " << path << " is not a valid cache file" << std::endl;
+        close();
+        return false;
+    }
+
+    sections = (const Section *)(file.data() + sizeof(Header));
+    sectionCount = header.sectionCount;
+
+    for (unsigned int i = 0; i < sectionCount; i++) {
+        if (sections[i].offset + sections[i].size > file.size()) {
+            std::cout << "Error: " << path << " cache file is truncated" << std::endl;
+            close();
+            return false;
+        }
+    }
+
+    // the write time orders files for eviction, access times may be off
+    HANDLE handle = CreateFile(path.c_str(), FILE_WRITE_ATTRIBUTES, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL,
+                               OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+
+    if (handle != INVALID_HANDLE_VALUE) {
+        FILETIME now;
+        GetSystemTimeAsFileTime(&now);
+        SetFileTime(handle, NULL, NULL, &now);
+        CloseHandle(handle);
+    }
+
+    std::cout << "OK: using cached data " << path << std::endl;
+    return true;
+}
+
+void VolumeCache::close()
+{
+    file.close();
+    sections = nullptr;
+    sectionCount = 0;
+}
+
+const VolumeCache::Section *VolumeCache::find(Kind kind, int level) const
+{
+    for (unsigned int i = 0; i < sectionCount; i++) {
+        if (sections[i].kind == kind && sections[i].level == level) return &sections[i];
+    }
+
+    return nullptr;
+}
+
+bool VolumeCache::viewLevel(int level, VolumeData &volume) const
+{
+    const Section *section = find(Level, level);
+
+    if (!section || section->format > VolumeData::Float32) return false;
+
+    volume.view((VolumeData::VoxelType)section->format, section->width, section->height, section->depth, sectionData(*section));
+    return true;
+}
+
+void VolumeCache::add(Kind kind, int level, unsigned int format, const glm::ivec3 &size, const void *data, size_t bytes)
+{
+    Section section = { (unsigned int)kind, level, format, size.x, size.y, size.z, 0, bytes };
+    entries.push_back(section);
+    entryData.push_back(data);
+}
+
+void VolumeCache::addLevel(int level, const VolumeData &volume)
+{
+    add(Level, level, volume.type(), glm::ivec3(volume.width(), volume.height(), volume.depth()), volume.data(), volume.sizeInBytes());
+}
+
+bool VolumeCache::store(const std::string &key)
+{
+    CreateDirectory(DIRECTORY, NULL);
+    std::string path = pathFor(key);
+    std::string partial = path + ".part";
+    std::ofstream out(partial.c_str(), std::ios::binary | std::ios::trunc);
+
+    if (!out.good()) {
+        std::cout << "Error: creating cache file " << partial << " failed" << std::endl;
+        return false;
+    }
+
+    // lay the sections out on page boundaries
+    size_t offset = sizeof(Header) + entries.size() * sizeof(Section);
+
+    for (auto &section : entries) {
+        offset = (offset + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+        section.offset = offset;
+        offset += (size_t)section.size;
+    }
+
+    Header header = { MAGIC, VERSION, (unsigned int)entries.size(), 0 };
+    out.write((const char *)&header, sizeof(Header));
+
+    if (!entries.empty()) out.write((const char *)&entries[0], entries.size() * sizeof(Section));
+
+    for (size_t i = 0; i < entries.size(); i++) {
+        out.seekp(entries[i].offset);
+        out.write((const char *)entryData[i], entries[i].size);
+    }
+
+    bool written = out.good();
+    out.close();
+    entries.clear();
+    entryData.clear();
+
+    if (!written || !MoveFileEx(partial.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING)) {
+        std::cout << "Error: writing cache file " << path << " failed" << std::endl;
+        DeleteFile(partial.c_str());
+        return false;
+    }
+
+    evict(path);
+    return true;
+}
+
+void VolumeCache::evict(const std::string &keep)
+{
+    struct Entry {
+        std::string path;
+        unsigned long long size;
+        unsigned long long lastWrite;
+    };
+    std::vector<Entry> files;
+    unsigned long long total = 0;
+    WIN32_FIND_DATA findData;
+    HANDLE find = FindFirstFile((std::string(DIRECTORY) + "\\*.vcache").c_str(), &findData);
+
+    if (find == INVALID_HANDLE_VALUE) return;
+
+    do {
+        Entry entry;
+        entry.path = std::string(DIRECTORY) + "\\" + findData.cFileName;
+        entry.size = (unsigned long long)findData.nFileSizeHigh << 32 | findData.nFileSizeLow;
+        entry.lastWrite = (unsigned long long)findData.ftLastWriteTime.dwHighDateTime << 32 | findData.ftLastWriteTime.dwLowDateTime;
+        total += entry.size;
+        files.push_back(entry);
+    } while (FindNextFile(find, &findData));
+
+    FindClose(find);
+    std::sort(files.begin(), files.end(), [](const Entry & a, const Entry & b) {
+        return a.lastWrite < b.lastWrite;
+    });
+
+    for (size_t i = 0; i < files.size() && total > MAX_BYTES; i++) {
+        // files mapped by a loaded volume can't be removed, they stay
+        if (files[i].path == keep || !DeleteFile(files[i].path.c_str())) continue;
+
+        total -= files[i].size;
+        std::cout << "OK: removed cache file " << files[i].path << std::endl;
+    }
+}
@@ -0,0 +1,104 @@
+#pragma once
+#include "Commons.h"
+#include "MappedFile.h"
+#include "VolumeData.h"
+
+// on disk store for everything derived from a volume file, named after the
+// identity of the file, a sampled hash of its voxel data and the parameters
+// used to derive it. sections are page aligned so volumes can be viewed
+// straight from the mapping. the directory is kept under MAX_BYTES by
+// removing the least recently used files
+//
+// | Header | Section * sectionCount | padding | section data ... |
+class VolumeCache {
+    public:
+        static const unsigned int MAGIC = 0x48434f56; // "VOCH"
+        static const unsigned int VERSION = 3;
+        static const size_t ALIGNMENT = 4096;
+        static const unsigned long long MAX_BYTES = 16ULL << 30;
+        static const char *DIRECTORY;
+
+        enum Kind {
+            // converted voxels of a pyramid level
+            Level,
+            // 256 bin voxel count
+            Histogram,
+            // glm::vec2 per cell, see MinMaxGrid
+            MinMax,
+            // octahedral directions of the budget level, format is the
+            // GradientVolume::Encoding
+            Gradients,
+            // unorm8 per voxel, same level as the directions
+            GradientMagnitudes,
+            // 256 x 256 voxel count over value and gradient, see JointHistogram
+            ValueGradientHistogram
+        };
+
+        struct Header {
+            unsigned int magic;
+            unsigned int version;
+            unsigned int sectionCount;
+            unsigned int reserved;
+        };
+
+        struct Section {
+            unsigned int kind;
+            int level;
+            // voxel type for levels, cell size for min max grids, encoding for
+            // gradients
+            unsigned int format;
+            int width;
+            int height;
+            int depth;
+            // from the start of the file
+            unsigned long long offset;
+            unsigned long long size;
+        };
+
+    private:
+        MappedFile file;
+        const Section *sections;
+        unsigned int sectionCount;
+        // sections queued for store
+        std::vector<Section> entries;
+        std::vector<const void *> entryData;
+
+        static std::string pathFor(const std::string &key);
+        // removes the oldest files over MAX_BYTES, keep is never removed
+        static void evict(const std::string &keep);
+
+        VolumeCache(const VolumeCache &);
+        VolumeCache &operator=(const VolumeCache &);
+    public:
+        // 64 bit fnv-1a over the first and last blocks and a few strided ones,
+        // only those pages are read from disk
+        static unsigned long long hash(const unsigned char *data, size_t size);
+        // path and last write time of the file plus the sampled hash of its
+        // voxels. parameters has to describe every setting that changes the
+        // stored data
+        static std::string keyFor(const std::string &path, const unsigned char *data, size_t size, const std::string &parameters);
+
+        bool open(const std::string &key);
+        void close();
+        bool isOpen() const
+        {
+            return file.isOpen();
+        }
+
+        const Section *find(Kind kind, int level = 0) const;
+        const void *sectionData(const Section &section) const
+        {
+            return file.data() + section.offset;
+        }
+        // zero copy view of a stored level
+        bool viewLevel(int level, VolumeData &volume) const;
+
+        // data has to stay alive until store is called
+        void add(Kind kind, int level, unsigned int format, const glm::ivec3 &size, const void *data, size_t bytes);
+        void addLevel(int level, const VolumeData &volume);
+        // writes the queued sections, the file only appears once complete
+        bool store(const std::string &key);
+
+        VolumeCache(void);
+        ~VolumeCache(void);
+};
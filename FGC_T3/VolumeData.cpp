@@ -0,0 +1,82 @@
+#include "VolumeData.h"
+
+VolumeData::VolumeData(void)
+{
+    voxelType = UInt8;
+    _width = _height = _depth = 0;
+    voxels = nullptr;
+}
+
+VolumeData::~VolumeData(void)
+{
+}
+
+void VolumeData::view(VoxelType type, int width, int height, int depth, const void *data)
+{
+    clear();
+    voxelType = type;
+    _width = width;
+    _height = height;
+    _depth = depth;
+    voxels = data;
+}
+
+void VolumeData::allocate(VoxelType type, int width, int height, int depth)
+{
+    clear();
+    voxelType = type;
+    _width = width;
+    _height = height;
+    _depth = depth;
+    storage.resize(sizeInBytes());
+    voxels = &storage[0];
+}
+
+void VolumeData::clear()
+{
+    std::vector<unsigned char>().swap(storage);
+    voxels = nullptr;
+    _width = _height = _depth = 0;
+}
+
+size_t VolumeData::bytesPerVoxel(VoxelType type)
+{
+    switch (type) {
+        case UInt16:
+            return sizeof(unsigned short);
+
+        case Float32:
+            return sizeof(float);
+
+        default:
+            return sizeof(unsigned char);
+    }
+}
+
+GLenum VolumeData::glType(VoxelType type)
+{
+    switch (type) {
+        case UInt16:
+            return GL_UNSIGNED_SHORT;
+
+        case Float32:
+            return GL_FLOAT;
+
+        default:
+            return GL_UNSIGNED_BYTE;
+    }
+}
+
+GLenum VolumeData::glInternalFormat(VoxelType type)
+{
+    switch (type) {
+        case UInt16:
+            return GL_R16;
+
+        case Float32:
+            return GL_R32F;
+
+        default:
+            return GL_R8;
+    }
+}
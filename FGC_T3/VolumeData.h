@@ -0,0 +1,136 @@
+#pragma once
+#include "Commons.h"
+
+// scalar volume kept in the voxel type it was stored with, either owning
+// its memory or viewing external memory such as a mapped file
+class VolumeData {
+    public:
+        enum VoxelType {
+            UInt8,
+            UInt16,
+            Float32
+        };
+
+    private:
+        VoxelType voxelType;
+        int _width;
+        int _height;
+        int _depth;
+        const void *voxels;
+        std::vector<unsigned char> storage;
+
+        VolumeData(const VolumeData &);
+        VolumeData &operator=(const VolumeData &);
+    public:
+        // zero copy, data has to outlive this volume
+        void view(VoxelType type, int width, int height, int depth, const void *data);
+        void allocate(VoxelType type, int width, int height, int depth);
+        void clear();
+
+        static size_t bytesPerVoxel(VoxelType type);
+        size_t bytesPerVoxel() const
+        {
+            return bytesPerVoxel(voxelType);
+        }
+        size_t voxelCount() const
+        {
+            return (size_t)_width * _height * _depth;
+        }
+        size_t sizeInBytes() const
+        {
+            return voxelCount() * bytesPerVoxel();
+        }
+        // gl upload parameters matching the native type
+        static GLenum glType(VoxelType type);
+        static GLenum glInternalFormat(VoxelType type);
+        GLenum glType() const
+        {
+            return glType(voxelType);
+        }
+        GLenum glInternalFormat() const
+        {
+            return glInternalFormat(voxelType);
+        }
+
+        const void *data() const
+        {
+            return voxels;
+        }
+        // only valid for allocated volumes
+        void *mutableData()
+        {
+            return storage.empty() ? nullptr : &storage[0];
+        }
+        template<typename T>
+        const T *as() const
+        {
+            return (const T *)voxels;
+        }
+
+        bool empty() const
+        {
+            return voxels == nullptr;
+        }
+        VoxelType type() const
+        {
+            return voxelType;
+        }
+        int width() const
+        {
+            return _width;
+        }
+        int height() const
+        {
+            return _height;
+        }
+        int depth() const
+        {
+            return _depth;
+        }
+
+        VolumeData(void);
+        ~VolumeData(void);
+};
+
+// typed read access to a volume, values are normalized to [0, 1] for
+// integer types the same way gl does for normalized textures
+template<typename T>
+class VoxelAccessor {
+    private:
+        const T *voxels;
+        int width;
+        int height;
+        int depth;
+        size_t sliceSize;
+        float scale;
+    public:
+        VoxelAccessor(const VolumeData &volume)
+        {
+            voxels = volume.as<T>();
+            width = volume.width();
+            height = volume.height();
+            depth = volume.depth();
+            sliceSize = (size_t)width * height;
+            scale = std::numeric_limits<T>::is_integer ? 1.f / std::numeric_limits<T>::max() : 1.f;
+        }
+
+        float operator[](size_t index) const
+        {
+            return voxels[index] * scale;
+        }
+
+        // clamps to the volume borders
+        float operator()(int x, int y, int z) const
+        {
+            x = glm::clamp(x, 0, width - 1);
+            y = glm::clamp(y, 0, height - 1);
+            z = glm::clamp(z, 0, depth - 1);
+            return voxels[x + y * width + z * sliceSize] * scale;
+        }
+
+        T raw(size_t index) const
+        {
+            return voxels[index];
+        }
+};
+
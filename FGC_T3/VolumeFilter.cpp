@@ -0,0 +1,134 @@
+#include "VolumeFilter.h"
+#include "Parallel.h"
+
+template<typename T>
+static T fromFloat(float value)
+{
+    // averages of in range values stay in range, integers only need rounding
+    return std::numeric_limits<T>::is_integer ? (T)(value + 0.5f) : (T)value;
+}
+
+// filters width interleaved lines of the given length in place, element i
+// of line k is at base[i * step + k]. window keeps the unfiltered input
+template<typename T>
+static void filterLines(T *base, int length, size_t step, int width, int radius, std::vector<float> &window, std::vector<float> &sums)
+{
+    window.resize((size_t)length * width);
+    sums.assign(width, 0.f);
+
+    for (int i = 0; i < length; i++) {
+        const T *src = base + i * step;
+        float *dst = &window[(size_t)i * width];
+
+        for (int k = 0; k < width; k++) dst[k] = (float)src[k];
+    }
+
+    for (int i = 0; i <= std::min(radius, length - 1); i++) {
+        const float *row = &window[(size_t)i * width];
+
+        for (int k = 0; k < width; k++) sums[k] += row[k];
+    }
+
+    for (int i = 0; i < length; i++) {
+        int low = i - radius;
+        int high = i + radius;
+        float inverseCount = 1.f / (std::min(high, length - 1) - std::max(low, 0) + 1);
+        T *dst = base + i * step;
+
+        for (int k = 0; k < width; k++) dst[k] = fromFloat<T>(sums[k] * inverseCount);
+
+        // slide the window one voxel forward
+        if (high + 1 < length) {
+            const float *row = &window[(size_t)(high + 1) * width];
+
+            for (int k = 0; k < width; k++) sums[k] += row[k];
+        }
+
+        if (low >= 0) {
+            const float *row = &window[(size_t)low * width];
+
+            for (int k = 0; k < width; k++) sums[k] -= row[k];
+        }
+    }
+}
+
+template<typename T>
+static void boxPasses(T *voxels, const glm::ivec3 &size, int radius)
+{
+    size_t rowSize = size.x;
+    size_t sliceSize = rowSize * size.y;
+    // x lines one by one, y and z a whole row of lines at a time so every
+    // read stays contiguous
+    parallelFor(0, size.z, [&](int first, int last) {
+        std::vector<float> window, sums;
+
+        for (int z = first; z < last; z++) {
+            for (int y = 0; y < size.y; y++) {
+                filterLines(voxels + y * rowSize + z * sliceSize, size.x, 1, 1, radius, window, sums);
+            }
+
+            filterLines(voxels + z * sliceSize, size.y, rowSize, size.x, radius, window, sums);
+        }
+    });
+    parallelFor(0, size.y, [&](int first, int last) {
+        std::vector<float> window, sums;
+
+        for (int y = first; y < last; y++) {
+            filterLines(voxels + y * rowSize, size.z, sliceSize, size.x, radius, window, sums);
+        }
+    });
+}
+
+void VolumeFilter::box(VolumeData &volume, int radius)
+{
+    if (radius <= 0 || volume.empty()) return;
+
+    glm::ivec3 size(volume.width(), volume.height(), volume.depth());
+
+    switch (volume.type()) {
+        case VolumeData::UInt16:
+            boxPasses((unsigned short *)volume.mutableData(), size, radius);
+            break;
+
+        case VolumeData::Float32:
+            boxPasses((float *)volume.mutableData(), size, radius);
+            break;
+
+        default:
+            boxPasses((unsigned char *)volume.mutableData(), size, radius);
+            break;
+    }
+}
+
+std::vector<int> VolumeFilter::gaussianBoxRadii(float sigma, int passes)
+{
+    // widths wl and wl + 2 mixed so the variances add up to sigma^2
+    float variance = 12.f * sigma * sigma;
+    int lower = (int)std::sqrt(variance / passes + 1.f);
+
+    if (lower % 2 == 0) lower--;
+
+    int lowerCount = (int)glm::round((variance - passes * lower * lower - 4.f * passes * lower - 3.f * passes) / (-4.f * lower - 4.f));
+    std::vector<int> radii;
+
+    for (int i = 0; i < passes; i++) radii.push_back(i < lowerCount ? (lower - 1) / 2 : (lower + 1) / 2);
+
+    return radii;
+}
+
+void VolumeFilter::apply(VolumeData &volume, Kind kind, int radius)
+{
+    if (kind == Box) {
+        box(volume, radius);
+        return;
+    }
+
+    std::vector<int> radii = gaussianBoxRadii(radius * 0.5f, 3);
+    // narrow gaussians round every pass down to nothing, a single radius 1
+    // box is the closest filter left
+    radii.erase(std::remove(radii.begin(), radii.end(), 0), radii.end());
+
+    if (radii.empty()) radii.push_back(1);
+
+    for (int passRadius : radii) box(volume, passRadius);
+}
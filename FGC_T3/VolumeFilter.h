@@ -0,0 +1,23 @@
+#pragma once
+#include "Commons.h"
+#include "VolumeData.h"
+
+// separable smoothing of a volume in place. x, y and z are filtered one
+// after the other with running sums so the cost per voxel is the same for
+// any kernel size, a gaussian is approximated by three box passes. voxels
+// near the borders average only the neighbours inside the volume
+class VolumeFilter {
+    public:
+        enum Kind {
+            Box,
+            Gaussian
+        };
+
+        // radius voxels on each side, a 7^3 kernel has radius 3. a gaussian
+        // of the given radius has a standard deviation of half of it
+        static void apply(VolumeData &volume, Kind kind, int radius);
+        static void box(VolumeData &volume, int radius);
+        // box radii whose successive passes approximate a gaussian of sigma
+        static std::vector<int> gaussianBoxRadii(float sigma, int passes);
+};
+
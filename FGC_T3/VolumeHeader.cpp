@@ -0,0 +1,265 @@
+#include "VolumeHeader.h"
+
+VolumeHeader::VolumeHeader(void)
+{
+    width = height = depth = 0;
+    type = VolumeData::UInt8;
+    isSigned = false;
+    bigEndian = false;
+    spacing = glm::vec3(1.f);
+    dataOffset = 0;
+}
+
+static std::string toLower(std::string value)
+{
+    std::transform(value.begin(), value.end(), value.begin(), ::tolower);
+    return value;
+}
+
+static std::string trim(const std::string &value)
+{
+    size_t first = value.find_first_not_of(" \t\r");
+
+    if (first == std::string::npos) return "";
+
+    return value.substr(first, value.find_last_not_of(" \t\r") - first + 1);
+}
+
+static std::string extensionOf(const char *pszFilepath)
+{
+    std::string path(pszFilepath);
+    size_t dot = path.find_last_of('.');
+    return dot == std::string::npos ? "" : toLower(path.substr(dot));
+}
+
+// detached data files are relative to the header unless absolute, i.e
+// C:\data.raw, \\server\data.raw or /data.raw
+static std::string resolveDataFile(const std::string &directory, const std::string &name)
+{
+    bool absolute = !name.empty() && (name[0] == '\\' || name[0] == '/' || (name.size() > 1 && name[1] == ':'));
+    return absolute ? name : directory + name;
+}
+
+bool VolumeHeader::isHeaderFile(const char *pszFilepath)
+{
+    std::string ext = extensionOf(pszFilepath);
+    return ext == ".nrrd" || ext == ".nhdr" || ext == ".mhd" || ext == ".mha";
+}
+
+VolumeHeader VolumeHeader::fromRaw(const char *pszFilepath, int width, int height, int depth, VolumeData::VoxelType type)
+{
+    VolumeHeader header;
+    header.width = width;
+    header.height = height;
+    header.depth = depth;
+    header.type = type;
+    header.dataFile = pszFilepath;
+    return header;
+}
+
+bool VolumeHeader::load(const char *pszFilepath)
+{
+    // only the header lines are read, voxels are left for the mapped reader
+    std::ifstream file(pszFilepath, std::ios::binary);
+
+    if (!file.is_open()) {
+        std::cout << "Error: opening " << pszFilepath << " file failed" << std::endl;
+        return false;
+    }
+
+    std::string path(pszFilepath);
+    size_t slash = path.find_last_of("\\/");
+    std::string directory = slash == std::string::npos ? "" : path.substr(0, slash + 1);
+    dataFile = pszFilepath;
+    std::string ext = extensionOf(pszFilepath);
+    bool parsed = ext == ".mhd" || ext == ".mha" ? parseMetaImage(file, directory) : parseNrrd(file, directory);
+
+    if (!parsed) {
+        std::cout << "Error: " << pszFilepath << " has an unsupported volume header" << std::endl;
+        return false;
+    }
+
+    if (width <= 0 || height <= 0 || depth <= 0) {
+        std::cout << "Error: " << pszFilepath << " header has no valid 3D size" << std::endl;
+        return false;
+    }
+
+    std::cout << "OK: " << pszFilepath << " header " << width << "x" << height << "x" << depth << ", data at " << dataFile << " + " << dataOffset << std::endl;
+    return true;
+}
+
+bool VolumeHeader::setType(const std::string &name)
+{
+    std::string n = toLower(name);
+    isSigned = false;
+
+    if (n == "uchar" || n == "unsigned char" || n == "uint8" || n == "uint8_t" || n == "met_uchar") {
+        type = VolumeData::UInt8;
+    } else if (n == "signed char" || n == "int8" || n == "int8_t" || n == "met_char") {
+        type = VolumeData::UInt8;
+        isSigned = true;
+    } else if (n == "ushort" || n == "unsigned short" || n == "unsigned short int" || n == "uint16" || n == "uint16_t" || n == "met_ushort") {
+        type = VolumeData::UInt16;
+    } else if (n == "short" || n == "short int" || n == "signed short" || n == "signed short int" || n == "int16" || n == "int16_t" ||
+               n == "met_short") {
+        type = VolumeData::UInt16;
+        isSigned = true;
+    } else if (n == "float" || n == "met_float") {
+        type = VolumeData::Float32;
+    } else {
+        std::cout << "Error: voxel type " << name << " is not supported" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+bool VolumeHeader::resolveOffset(std::streamoff headerEnd, long long skip)
+{
+    if (skip < 0) {
+        // skip -1 means the voxels are the last bytes of the file
+        std::ifstream data(dataFile.c_str(), std::ios::binary | std::ios::ate);
+
+        if (!data.is_open() || (size_t)data.tellg() < dataSize()) return false;
+
+        dataOffset = (size_t)data.tellg() - dataSize();
+    } else {
+        // attached data starts right after the header
+        dataOffset = (size_t)skip + (headerEnd > 0 ? (size_t)headerEnd : 0);
+    }
+
+    return true;
+}
+
+bool VolumeHeader::parseNrrd(std::ifstream &file, const std::string &directory)
+{
+    std::string line;
+    std::getline(file, line);
+
+    if (line.compare(0, 4, "NRRD") != 0) return false;
+
+    std::string detachedFile;
+    long long byteSkip = 0;
+    int dimension = 0;
+
+    while (std::getline(file, line)) {
+        line = trim(line);
+
+        // a blank line ends the header, attached data follows it
+        if (line.empty()) break;
+
+        if (line[0] == '#') continue;
+
+        size_t colon = line.find(':');
+
+        if (colon == std::string::npos) continue;
+
+        std::string key = toLower(trim(line.substr(0, colon)));
+        std::string value = trim(line.substr(colon + 1));
+
+        // key:=value pairs are user data
+        if (!value.empty() && value[0] == '=') continue;
+
+        std::istringstream stream(value);
+
+        if (key == "type") {
+            if (!setType(value)) return false;
+        } else if (key == "dimension") {
+            stream >> dimension;
+        } else if (key == "sizes") {
+            stream >> width >> height >> depth;
+        } else if (key == "endian") {
+            bigEndian = toLower(value) == "big";
+        } else if (key == "encoding") {
+            if (toLower(value) != "raw") {
+                std::cout << "Error: nrrd encoding " << value << " is not supported" << std::endl;
+                return false;
+            }
+        } else if (key == "spacings") {
+            stream >> spacing.x >> spacing.y >> spacing.z;
+        } else if (key == "space directions") {
+            // spacing is the length of every axis direction vector
+            glm::vec3 axis[3];
+            char separator;
+
+            for (int i = 0; i < 3; i++) {
+                stream >> separator >> axis[i].x >> separator >> axis[i].y >> separator >> axis[i].z >> separator;
+            }
+
+            if (stream) spacing = glm::vec3(glm::length(axis[0]), glm::length(axis[1]), glm::length(axis[2]));
+        } else if (key == "byte skip") {
+            stream >> byteSkip;
+        } else if (key == "data file" || key == "datafile") {
+            detachedFile = value;
+        }
+    }
+
+    if (dimension != 3) {
+        std::cout << "Error: only 3 dimensional nrrd files are supported" << std::endl;
+        return false;
+    }
+
+    if (!detachedFile.empty()) {
+        dataFile = resolveDataFile(directory, detachedFile);
+        return resolveOffset(0, byteSkip);
+    }
+
+    return resolveOffset(file.tellg(), byteSkip);
+}
+
+bool VolumeHeader::parseMetaImage(std::ifstream &file, const std::string &directory)
+{
+    std::string line;
+    long long headerSize = 0;
+    int dimensions = 0;
+    bool local = false;
+
+    while (std::getline(file, line)) {
+        size_t equals = line.find('=');
+
+        if (equals == std::string::npos) continue;
+
+        std::string key = toLower(trim(line.substr(0, equals)));
+        std::string value = trim(line.substr(equals + 1));
+        std::istringstream stream(value);
+
+        if (key == "ndims") {
+            stream >> dimensions;
+        } else if (key == "dimsize") {
+            stream >> width >> height >> depth;
+        } else if (key == "elementtype") {
+            if (!setType(value)) return false;
+        } else if (key == "elementbyteordermsb" || key == "binarydatabyteordermsb") {
+            bigEndian = toLower(value) == "true";
+        } else if (key == "elementspacing" || key == "elementsize") {
+            stream >> spacing.x >> spacing.y >> spacing.z;
+        } else if (key == "headersize") {
+            stream >> headerSize;
+        } else if (key == "compresseddata") {
+            if (toLower(value) == "true") {
+                std::cout << "Error: compressed metaimage data is not supported" << std::endl;
+                return false;
+            }
+        } else if (key == "elementdatafile") {
+            // always the last field, voxels follow right after for LOCAL
+            if (toLower(value) == "local") {
+                local = true;
+            } else {
+                dataFile = resolveDataFile(directory, value);
+            }
+
+            break;
+        }
+    }
+
+    if (dimensions != 3) {
+        std::cout << "Error: only 3 dimensional metaimage files are supported" << std::endl;
+        return false;
+    }
+
+    if (local) {
+        return resolveOffset(file.tellg(), headerSize);
+    }
+
+    return resolveOffset(0, headerSize);
+}
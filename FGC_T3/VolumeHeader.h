@@ -0,0 +1,45 @@
+#pragma once
+#include "Commons.h"
+#include "VolumeData.h"
+
+// description of a volume stored in a file, read from nrrd (.nrrd, .nhdr)
+// or metaimage (.mhd, .mha) headers. only raw encoded data is supported
+class VolumeHeader {
+    private:
+        bool parseNrrd(std::ifstream &file, const std::string &directory);
+        bool parseMetaImage(std::ifstream &file, const std::string &directory);
+        bool setType(const std::string &name);
+        bool resolveOffset(std::streamoff headerEnd, long long skip);
+
+    public:
+        int width;
+        int height;
+        int depth;
+        // type the voxels are kept as once loaded
+        VolumeData::VoxelType type;
+        // signed data is shifted to the unsigned range on load
+        bool isSigned;
+        bool bigEndian;
+        glm::vec3 spacing;
+        // file holding the voxels and where they start inside it
+        std::string dataFile;
+        size_t dataOffset;
+
+        bool load(const char *pszFilepath);
+        static bool isHeaderFile(const char *pszFilepath);
+        static VolumeHeader fromRaw(const char *pszFilepath, int width, int height, int depth, VolumeData::VoxelType type);
+
+        size_t dataSize() const
+        {
+            return (size_t)width * height * depth * VolumeData::bytesPerVoxel(type);
+        }
+        // false when the file bytes can be used as voxels as they are,
+        // float data is always rescaled to [0, 1]
+        bool needsConversion() const
+        {
+            return isSigned || type == VolumeData::Float32 || (bigEndian && type != VolumeData::UInt8);
+        }
+
+        VolumeHeader(void);
+};
+
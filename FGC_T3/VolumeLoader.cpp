@@ -0,0 +1,465 @@
+#include "VolumeLoader.h"
+#include "Parallel.h"
+#include "ImageStackImporter.h"
+#include "VoxelConverter.h"
+
+VolumeAsset::VolumeAsset(void)
+{
+    size = glm::ivec3(0);
+    paged = false;
+    spacing = glm::vec3(1.f);
+    budgetLevel = 0;
+    gradientTexture = 0;
+    gradientMagnitudeTexture = 0;
+    histogram.fill(0);
+}
+
+VolumeLoader::VolumeLoader(void) : stage(Idle), progress(0.f), streaming(false)
+{
+    options.budgetBytes = 0;
+    options.maxTextureSize = 0;
+    options.window = glm::vec2(0.f, 1.f);
+    options.paged = false;
+    options.compress = false;
+    options.gradients = false;
+    options.gradientOperator = GradientVolume::CentralDifference;
+    options.gradientEncoding = GradientVolume::Octahedral8;
+    options.smoothing = VolumeFilter::Box;
+    options.smoothRadius = 0;
+    options.smoothScalars = false;
+    scalarsSmoothed = false;
+}
+
+VolumeLoader::~VolumeLoader(void)
+{
+    if (worker.joinable()) worker.join();
+}
+
+bool VolumeLoader::start(const char *pszFilepath, int width, int height, int numCuts, const Options &options)
+{
+    if (isBusy()) {
+        std::cout << "Error: a volume is still loading" << std::endl;
+        return false;
+    }
+
+    if (worker.joinable()) worker.join();
+
+    this->options = options;
+    asset.reset(new VolumeAsset());
+    readySlabs.clear();
+    streaming = false;
+    scalarsSmoothed = false;
+    progress = 0.f;
+    stage = Reading;
+    worker = std::thread(&VolumeLoader::run, this, std::string(pszFilepath), width, height, numCuts);
+    return true;
+}
+
+bool VolumeLoader::isBusy() const
+{
+    // a finished load counts until the render thread takes it
+    return stage != Idle && stage != Failed;
+}
+
+VolumeAsset *VolumeLoader::pendingAsset()
+{
+    return streaming ? asset.get() : nullptr;
+}
+
+bool VolumeLoader::popSlab(VolumeStreamer::Slab &slab)
+{
+    std::lock_guard<std::mutex> lock(slabMutex);
+
+    if (readySlabs.empty()) return false;
+
+    slab = readySlabs.front();
+    readySlabs.pop_front();
+    return true;
+}
+
+bool VolumeLoader::hasSlabs()
+{
+    std::lock_guard<std::mutex> lock(slabMutex);
+    return !readySlabs.empty();
+}
+
+std::unique_ptr<VolumeAsset> VolumeLoader::take()
+{
+    if (worker.joinable()) worker.join();
+
+    std::unique_ptr<VolumeAsset> loaded;
+
+    if (stage == Finished) loaded = std::move(asset);
+
+    asset.reset();
+    streaming = false;
+    stage = Idle;
+    return loaded;
+}
+
+static bool hasExtension(const std::string &path, const char *extension)
+{
+    std::string ext(extension);
+
+    if (path.size() < ext.size()) return false;
+
+    std::string tail = path.substr(path.size() - ext.size());
+    std::transform(tail.begin(), tail.end(), tail.begin(), ::tolower);
+    return tail == ext;
+}
+
+void VolumeLoader::run(std::string path, int width, int height, int numCuts)
+{
+    bool volumeLoaded = false;
+    VolumeHeader header;
+
+    if (hasExtension(path, ".bvol")) {
+        volumeLoaded = loadBrickedVolume(path.c_str());
+    } else if (ImageStackImporter::isImageFile(path.c_str())) {
+        volumeLoaded = loadImageStack(path.c_str());
+    } else if (VolumeHeader::isHeaderFile(path.c_str())) {
+        volumeLoaded = header.load(path.c_str()) && loadVolume(header);
+    } else {
+        volumeLoaded = loadVolume(VolumeHeader::fromRaw(path.c_str(), width, height, numCuts, VolumeData::UInt8));
+    }
+
+    if (volumeLoaded && !asset->paged) {
+        asset->size = glm::ivec3(asset->volume.width(), asset->volume.height(), asset->volume.depth());
+    }
+
+    // bricked and image stack volumes aren't cached
+    if (volumeLoaded && options.gradients && !asset->paged && asset->gradients.empty()) {
+        computeGradients();
+    }
+
+    // mapped voxels are paged out by the os, only owned copies are worth compressing
+    if (volumeLoaded && options.compress && !asset->paged && asset->volume.mutableData()) {
+        asset->compressed.compress(asset->volume);
+    }
+
+    progress = 1.f;
+    stage = volumeLoaded ? Finished : Failed;
+}
+
+int VolumeLoader::selectBudgetLevel(int levelCount) const
+{
+    const VolumeData &volume = asset->volume;
+    int level = VolumePyramid::selectLevel(glm::ivec3(volume.width(), volume.height(), volume.depth()), volume.bytesPerVoxel(),
+                                           levelCount, options.budgetBytes, options.maxTextureSize);
+
+    if (level > 0) {
+        std::cout << "volume exceeds the gpu budget, rendering from level " << level << std::endl;
+    }
+
+    return level;
+}
+
+// counts voxels per 256 bins straight from the native volume values
+template<typename T>
+static void accumulateHistogram(const VoxelAccessor<T> &voxels, size_t first, size_t count, std::array<unsigned int, 256> &histogram)
+{
+    for (size_t i = first; i < first + count; i++) {
+        histogram[glm::clamp((int)(voxels[i] * 255.f), 0, 255)]++;
+    }
+}
+
+void VolumeLoader::accumulateHistogram(const VolumeData &volume, size_t first, size_t count, std::array<unsigned int, 256> &histogram)
+{
+    switch (volume.type()) {
+        case VolumeData::UInt16:
+            ::accumulateHistogram(VoxelAccessor<unsigned short>(volume), first, count, histogram);
+            break;
+
+        case VolumeData::Float32:
+            ::accumulateHistogram(VoxelAccessor<float>(volume), first, count, histogram);
+            break;
+
+        default:
+            ::accumulateHistogram(VoxelAccessor<unsigned char>(volume), first, count, histogram);
+            break;
+    }
+}
+
+void VolumeLoader::computeStatistics()
+{
+    const VolumeData &volume = asset->volume;
+    asset->jointHistogram.build(volume, asset->histogram);
+    asset->minMax.build(volume);
+}
+
+void VolumeLoader::computeGradients()
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    const VolumeData &level = asset->pyramid.level(asset->budgetLevel);
+
+    if (options.smoothRadius > 0 && !scalarsSmoothed) {
+        // only the gradients see the smoothing, the level is left as is
+        VolumeData smoothed;
+        smoothed.allocate(level.type(), level.width(), level.height(), level.depth());
+        memcpy(smoothed.mutableData(), level.data(), level.sizeInBytes());
+        VolumeFilter::apply(smoothed, options.smoothing, options.smoothRadius);
+        asset->gradients.compute(smoothed, options.gradientOperator, options.gradientEncoding);
+    } else {
+        asset->gradients.compute(level, options.gradientOperator, options.gradientEncoding);
+    }
+
+    std::chrono::duration<float> elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << "OK: gradients computed in " << elapsed.count() << " s" << std::endl;
+}
+
+bool VolumeLoader::restoreCache()
+{
+    const VolumeCache &cache = asset->cache;
+    const VolumeCache::Section *histogram = cache.find(VolumeCache::Histogram);
+    const VolumeCache::Section *minMax = cache.find(VolumeCache::MinMax);
+
+    const VolumeCache::Section *jointHistogram = cache.find(VolumeCache::ValueGradientHistogram);
+
+    if (!histogram || !minMax || histogram->size != sizeof(asset->histogram)) return false;
+
+    if (!jointHistogram || jointHistogram->size != JointHistogram::VALUE_BINS * JointHistogram::GRADIENT_BINS * sizeof(unsigned int)) {
+        return false;
+    }
+
+    // gradients belong to the level the budget picked when they were stored
+    const VolumeCache::Section *gradients = cache.find(VolumeCache::Gradients, asset->budgetLevel);
+    const VolumeCache::Section *magnitudes = cache.find(VolumeCache::GradientMagnitudes, asset->budgetLevel);
+
+    if (options.gradients && (!gradients || !magnitudes || gradients->format != (unsigned int)options.gradientEncoding)) return false;
+
+    const VolumeData &volume = asset->volume;
+    int levelCount = VolumePyramid::levelCountFor(glm::ivec3(volume.width(), volume.height(), volume.depth()));
+    asset->pyramid.setBase(volume);
+
+    for (int l = 1; l < levelCount; l++) {
+        std::unique_ptr<VolumeData> level(new VolumeData());
+
+        if (!cache.viewLevel(l, *level)) return false;
+
+        asset->pyramid.addLevel(std::move(level));
+    }
+
+    memcpy(&asset->histogram[0], cache.sectionData(*histogram), sizeof(asset->histogram));
+    asset->jointHistogram.assign((const unsigned int *)cache.sectionData(*jointHistogram));
+    asset->minMax.assign(glm::ivec3(minMax->width, minMax->height, minMax->depth), minMax->format,
+                         (const glm::vec2 *)cache.sectionData(*minMax));
+
+    if (options.gradients) {
+        asset->gradients.view(glm::ivec3(gradients->width, gradients->height, gradients->depth), options.gradientEncoding,
+                              cache.sectionData(*gradients), cache.sectionData(*magnitudes));
+    }
+
+    return true;
+}
+
+void VolumeLoader::storeCache(const std::string &key, bool storeBase)
+{
+    const VolumePyramid &pyramid = asset->pyramid;
+    const MinMaxGrid &minMax = asset->minMax;
+    VolumeCache cache;
+
+    // unconverted voxels are read from the source file anyway
+    if (storeBase) cache.addLevel(0, pyramid.level(0));
+
+    for (int l = 1; l < pyramid.levelCount(); l++) {
+        cache.addLevel(l, pyramid.level(l));
+    }
+
+    cache.add(VolumeCache::Histogram, 0, 0, glm::ivec3(256, 1, 1), &asset->histogram[0], sizeof(asset->histogram));
+    cache.add(VolumeCache::ValueGradientHistogram, 0, 0, glm::ivec3(JointHistogram::VALUE_BINS, JointHistogram::GRADIENT_BINS, 1),
+              asset->jointHistogram.data(), asset->jointHistogram.sizeInBytes());
+    cache.add(VolumeCache::MinMax, 0, minMax.getCellSize(), minMax.getSize(), minMax.data(), minMax.cellCount() * sizeof(glm::vec2));
+    if (!asset->gradients.empty()) {
+        const GradientVolume &gradients = asset->gradients;
+        cache.add(VolumeCache::Gradients, asset->budgetLevel, gradients.getEncoding(), gradients.getSize(), gradients.directionData(),
+                  gradients.directionBytes());
+        cache.add(VolumeCache::GradientMagnitudes, asset->budgetLevel, 0, gradients.getSize(), gradients.magnitudeData(),
+                  gradients.magnitudeBytes());
+    }
+
+    cache.store(key);
+}
+
+bool VolumeLoader::loadVolume(const VolumeHeader &header)
+{
+    int width = header.width, height = header.height, numCuts = header.depth;
+    const char *pszFilepath = header.dataFile.c_str();
+    size_t sliceSize = (size_t)width * height;
+    size_t sliceBytes = sliceSize * VolumeData::bytesPerVoxel(header.type);
+    MappedFile &volumeFile = asset->file;
+    VolumeData &volume = asset->volume;
+    VolumeCache &cache = asset->cache;
+
+    if (!volumeFile.open(pszFilepath)) {
+        return false;
+    } else {
+        std::cout << "OK: opening " << pszFilepath << " file successed" << std::endl;
+    }
+
+    if (volumeFile.size() < header.dataOffset + header.dataSize()) {
+        std::cout << "Error: reading " << pszFilepath << " file failed, expected " << header.dataSize() << " bytes at offset "
+                  << header.dataOffset << std::endl;
+        volumeFile.close();
+        return false;
+    }
+
+    // voxels are read in place at the data offset, headers are never buffered
+    const unsigned char *source = volumeFile.data() + header.dataOffset;
+    glm::vec2 range(0.f, 1.f);
+    // every setting the derived data depends on
+    std::stringstream parameters;
+    parameters << header.type << " " << width << " " << height << " " << numCuts << " " << header.isSigned << " " << header.bigEndian
+               << " " << options.window.x << " " << options.window.y << " " << VolumePyramid::DEFAULT_MIN_SIZE << " "
+               << MinMaxGrid::DEFAULT_CELL_SIZE << " " << options.gradients << " " << options.gradientOperator << " "
+               << options.gradientEncoding << " " << options.smoothing << " " << options.smoothRadius << " "
+               << options.smoothScalars;
+    std::string key = VolumeCache::keyFor(pszFilepath, source, header.dataSize(), parameters.str());
+    // windowed voxels are remapped in the conversion pass
+    bool smoothScalars = options.smoothScalars && options.smoothRadius > 0;
+    // smoothed voxels get their own copy too, and so do voxels a header
+    // offset leaves misaligned, views are read through typed pointers
+    bool needsConversion = header.needsConversion() || !VoxelConverter::isIdentityWindow(options.window) || smoothScalars ||
+                           header.dataOffset % VolumeData::bytesPerVoxel(header.type) != 0;
+    bool cached = cache.open(key) && (!needsConversion || cache.viewLevel(0, volume));
+    progress = 0.1f;
+
+    if (!cached) {
+        cache.close();
+    }
+
+    if (cached && needsConversion) {
+        // converted voxels come straight from the cache mapping
+    } else if (needsConversion) {
+        volume.allocate(header.type, width, height, numCuts);
+
+        if (header.type == VolumeData::Float32) range = VoxelConverter::floatRange(source, volume.voxelCount(), header.bigEndian);
+    } else {
+        // the mapped pages are the volume, no widened copy is made
+        volume.view(header.type, width, height, numCuts, source);
+    }
+
+    VoxelConverter::Params conversion = VoxelConverter::makeParams(header.type, header.isSigned,
+                                        header.bigEndian && header.type != VolumeData::UInt8, range, options.window);
+    bool convert = needsConversion && !cached;
+    asset->spacing = header.spacing;
+    asset->budgetLevel = selectBudgetLevel(VolumePyramid::levelCountFor(glm::ivec3(width, height, numCuts)));
+    // full resolution slabs are shown as they arrive when level 0 fits
+    // smoothed slabs aren't final until their neighbours are converted
+    streaming = asset->budgetLevel == 0 && !smoothScalars;
+    VolumeStreamer streamer;
+    int slabCount = (numCuts + streamer.slabCuts - 1) / streamer.slabCuts;
+    int slabsDone = 0;
+
+    // fault the slab pages in, mapped files are read by the os on first touch.
+    // unconverted volumes are views of the file or cache mapping, the render
+    // thread would otherwise stall on disk uploading them
+    streamer.read = [&](const VolumeStreamer::Slab & slab) {
+        const unsigned char *pages = convert ? source : (const unsigned char *)volume.data();
+        MappedFile::touch(pages + slab.firstCut * sliceBytes, slab.cutCount * sliceBytes);
+    };
+
+    if (convert) {
+        streamer.convert = [&](const VolumeStreamer::Slab & slab) {
+            size_t offset = slab.firstCut * sliceBytes;
+            VoxelConverter::convert(conversion, source + offset, (unsigned char *)volume.mutableData() + offset, slab.cutCount * sliceSize);
+        };
+    }
+
+    // the render thread uploads published slabs on its next frame
+    streamer.upload = [&](const VolumeStreamer::Slab & slab) {
+        if (streaming) {
+            std::lock_guard<std::mutex> lock(slabMutex);
+            readySlabs.push_back(slab);
+        }
+
+        progress = 0.1f + 0.7f * ++slabsDone / slabCount;
+    };
+    streamer.run(numCuts);
+    stage = Building;
+
+    // cached voxels were smoothed before they were stored
+    if (smoothScalars && convert) VolumeFilter::apply(volume, options.smoothing, options.smoothRadius);
+
+    scalarsSmoothed = smoothScalars;
+
+    // coarser levels for the memory budget and interaction
+    if (!cached || !restoreCache()) {
+        asset->pyramid.build(volume);
+        computeStatistics();
+
+        if (options.gradients) computeGradients();
+
+        storeCache(key, needsConversion);
+    }
+
+    std::cout << "OK: reading " << pszFilepath << " file successed" << std::endl;
+    return true;
+}
+
+bool VolumeLoader::loadBrickedVolume(const char *pszFilepath)
+{
+    BrickedVolume &brickedVolume = asset->bricked;
+    VolumeData &volume = asset->volume;
+    VolumePyramid &pyramid = asset->pyramid;
+
+    if (!brickedVolume.open(pszFilepath)) {
+        return false;
+    }
+
+    const BrickedVolume::Header &header = brickedVolume.getHeader();
+    // the finest level stays on disk and is paged in by bricks, the finest
+    // coarser level fitting a quarter of the budget covers missing bricks
+    asset->paged = options.paged && header.levelCount > 1;
+    asset->size = brickedVolume.levelSize(0);
+    int firstLevel = 0;
+
+    if (asset->paged) {
+        firstLevel = std::max(1, VolumePyramid::selectLevel(asset->size, VolumeData::bytesPerVoxel((VolumeData::VoxelType)header.voxelType),
+                              header.levelCount, options.budgetBytes / 4, options.maxTextureSize));
+    }
+
+    if (!brickedVolume.readLevel(firstLevel, volume)) {
+        std::cout << "Error: reading " << pszFilepath << " bricks failed" << std::endl;
+        return false;
+    }
+
+    progress = 0.5f;
+    stage = Building;
+
+    // stored levels are reused, single level files get a pyramid built
+    if (header.levelCount > 1) {
+        pyramid.setBase(volume);
+
+        for (int l = firstLevel + 1; l < header.levelCount; l++) {
+            std::unique_ptr<VolumeData> level(new VolumeData());
+            brickedVolume.readLevel(l, *level);
+            pyramid.addLevel(std::move(level));
+        }
+    } else {
+        pyramid.build(volume);
+    }
+
+    // statistics of paged volumes come from the resident level
+    computeStatistics();
+    asset->budgetLevel = asset->paged ? 0 : selectBudgetLevel(pyramid.levelCount());
+    std::cout << "OK: bricked volume " << pszFilepath << " loaded" << std::endl;
+    return true;
+}
+
+bool VolumeLoader::loadImageStack(const char *pszFilepath)
+{
+    if (!ImageStackImporter::import(pszFilepath, asset->volume)) {
+        return false;
+    }
+
+    progress = 0.8f;
+    stage = Building;
+    scalarsSmoothed = options.smoothScalars && options.smoothRadius > 0;
+
+    if (scalarsSmoothed) VolumeFilter::apply(asset->volume, options.smoothing, options.smoothRadius);
+
+    asset->pyramid.build(asset->volume);
+    computeStatistics();
+    asset->budgetLevel = selectBudgetLevel(asset->pyramid.levelCount());
+    return true;
+}
@@ -0,0 +1,139 @@
+#pragma once
+#include "Commons.h"
+#include "MappedFile.h"
+#include "VolumeData.h"
+#include "BrickedVolume.h"
+#include "VolumePyramid.h"
+#include "VolumeHeader.h"
+#include "VolumeStreamer.h"
+#include "VolumeCache.h"
+#include "MinMaxGrid.h"
+#include "CompressedVolume.h"
+#include "GradientVolume.h"
+#include "VolumeFilter.h"
+#include "JointHistogram.h"
+
+// everything read from one volume file, built by the loader and swapped
+// into the model as a whole once its textures are on the gpu
+struct VolumeAsset {
+    // source file pages, kept mapped while the volume is in use
+    MappedFile file;
+    BrickedVolume bricked;
+    // native precision voxels, read through VoxelAccessor
+    VolumeData volume;
+    VolumePyramid pyramid;
+    // derived data, either computed on load or read from the cache
+    VolumeCache cache;
+    std::array<unsigned int, 256> histogram;
+    JointHistogram jointHistogram;
+    MinMaxGrid minMax;
+    // of the budget level, empty unless requested
+    GradientVolume gradients;
+    // replaces volume as the cpu copy once level 0 is on the gpu
+    CompressedVolume compressed;
+    // full resolution size, paged assets only hold coarser levels in volume
+    glm::ivec3 size;
+    bool paged;
+    // voxel size from the volume header
+    glm::vec3 spacing;
+    // finest level that fits the gpu budget
+    int budgetLevel;
+    // one texture per pyramid level, 0 for levels over the gpu budget
+    std::vector<GLuint> textures;
+    // octahedral directions as rg snorm and magnitudes as r8, 0 without
+    // precomputed gradients
+    GLuint gradientTexture;
+    GLuint gradientMagnitudeTexture;
+
+    VolumeAsset(void);
+};
+
+// reads, converts and builds the pyramid of a volume on a background
+// thread. gl is never touched here, level 0 slabs are handed to the render
+// thread as they are converted so it can show them while the rest loads
+class VolumeLoader {
+    public:
+        enum Stage {
+            Idle,
+            Reading,
+            Building,
+            Finished,
+            Failed
+        };
+
+        struct Options {
+            size_t budgetBytes;
+            int maxTextureSize;
+            // normalized value range stretched over the voxel type on conversion
+            glm::vec2 window;
+            // bricked files keep their finest level on disk, see BrickPager
+            bool paged;
+            // keep the cpu copy of converted voxels compressed
+            bool compress;
+            // gradients of the rendered level, computed or read from the cache
+            bool gradients;
+            GradientVolume::Operator gradientOperator;
+            GradientVolume::Encoding gradientEncoding;
+            // box or gaussian smoothing over radius voxels, 0 disables it
+            VolumeFilter::Kind smoothing;
+            int smoothRadius;
+            // smooth the voxels themselves, otherwise only the gradients
+            bool smoothScalars;
+        };
+
+    private:
+        std::thread worker;
+        std::unique_ptr<VolumeAsset> asset;
+        std::atomic<int> stage;
+        std::atomic<float> progress;
+        // set once the asset volume has its size and storage
+        std::atomic<bool> streaming;
+        std::mutex slabMutex;
+        std::deque<VolumeStreamer::Slab> readySlabs;
+        Options options;
+        // the gradients of smoothed voxels need no smoothing of their own
+        bool scalarsSmoothed;
+
+        void run(std::string path, int width, int height, int numCuts);
+        bool loadVolume(const VolumeHeader &header);
+        bool loadBrickedVolume(const char *pszFilepath);
+        bool loadImageStack(const char *pszFilepath);
+        // histograms and min max grid of the asset volume
+        void computeStatistics();
+        void computeGradients();
+        bool restoreCache();
+        void storeCache(const std::string &key, bool storeBase);
+        int selectBudgetLevel(int levelCount) const;
+
+        VolumeLoader(const VolumeLoader &);
+        VolumeLoader &operator=(const VolumeLoader &);
+
+    public:
+        // adds the voxels in [first, first + count) to 256 normalized bins
+        static void accumulateHistogram(const VolumeData &volume, size_t first, size_t count,
+                                        std::array<unsigned int, 256> &histogram);
+        // starts loading pszFilepath, width height and numCuts are only
+        // used by headerless .raw files. false while a load is running
+        bool start(const char *pszFilepath, int width, int height, int numCuts, const Options &options);
+        bool isBusy() const;
+        Stage getStage() const
+        {
+            return (Stage)stage.load();
+        }
+        // 0 to 1 over the whole load
+        float getProgress() const
+        {
+            return progress.load();
+        }
+        // asset being loaded, null until its volume can be read. only the
+        // render thread may touch its textures
+        VolumeAsset *pendingAsset();
+        // level 0 slab of the pending asset that finished converting
+        bool popSlab(VolumeStreamer::Slab &slab);
+        bool hasSlabs();
+        // joins the worker and hands over the asset, null if loading failed
+        std::unique_ptr<VolumeAsset> take();
+
+        VolumeLoader(void);
+        ~VolumeLoader(void);
+};
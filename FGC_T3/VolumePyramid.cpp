@@ -0,0 +1,154 @@
+#include "VolumePyramid.h"
+#include "Parallel.h"
+
+VolumePyramid::VolumePyramid(void)
+{
+    base = nullptr;
+}
+
+VolumePyramid::~VolumePyramid(void)
+{
+}
+
+void VolumePyramid::build(const VolumeData &source, int minSize)
+{
+    clear();
+    base = &source;
+    int count = levelCountFor(glm::ivec3(source.width(), source.height(), source.depth()), minSize);
+
+    for (int l = 1; l < count; l++) {
+        std::unique_ptr<VolumeData> next(new VolumeData());
+        downsample(level(l - 1), *next);
+        coarser.push_back(std::move(next));
+    }
+}
+
+void VolumePyramid::setBase(const VolumeData &source)
+{
+    clear();
+    base = &source;
+}
+
+void VolumePyramid::addLevel(std::unique_ptr<VolumeData> level)
+{
+    coarser.push_back(std::move(level));
+}
+
+void VolumePyramid::clear()
+{
+    coarser.clear();
+    base = nullptr;
+}
+
+glm::ivec3 VolumePyramid::levelSize(const glm::ivec3 &size, int level)
+{
+    int round = (1 << level) - 1;
+    return glm::max((size + glm::ivec3(round)) / (1 << level), glm::ivec3(1));
+}
+
+int VolumePyramid::levelCountFor(const glm::ivec3 &size, int minSize)
+{
+    int maxSize = std::max(std::max(size.x, size.y), size.z);
+    int count = 1;
+
+    while ((maxSize >> count) >= minSize) count++;
+
+    return count;
+}
+
+int VolumePyramid::selectLevel(const glm::ivec3 &size, size_t bytesPerVoxel, int levelCount, size_t budgetBytes, int maxTextureSize)
+{
+    // bytes needed by each level plus every coarser level
+    std::vector<size_t> chainBytes(levelCount + 1, 0);
+
+    for (int l = levelCount - 1; l >= 0; l--) {
+        glm::ivec3 s = levelSize(size, l);
+        chainBytes[l] = chainBytes[l + 1] + (size_t)s.x * s.y * s.z * bytesPerVoxel;
+    }
+
+    for (int l = 0; l < levelCount; l++) {
+        glm::ivec3 s = levelSize(size, l);
+
+        if (chainBytes[l] <= budgetBytes && s.x <= maxTextureSize && s.y <= maxTextureSize && s.z <= maxTextureSize) {
+            return l;
+        }
+    }
+
+    // the coarsest level is always kept
+    return levelCount - 1;
+}
+
+template<typename T>
+static void downsampleVolume(const VolumeData &src, VolumeData &dst)
+{
+    static const float weights[4] = { 1.f / 8.f, 3.f / 8.f, 3.f / 8.f, 1.f / 8.f };
+    int w = src.width(), h = src.height(), d = src.depth();
+    glm::ivec3 size = VolumePyramid::levelSize(glm::ivec3(w, h, d), 1);
+    int dw = size.x, dh = size.y, dd = size.z;
+    dst.allocate(src.type(), dw, dh, dd);
+    const T *in = src.as<T>();
+    T *out = (T *)dst.mutableData();
+    float maxValue = std::numeric_limits<T>::is_integer ? (float)std::numeric_limits<T>::max() : std::numeric_limits<float>::max();
+    // every output slice filters its four source slices, x then y, and
+    // blends them along z so scratch memory stays at a few slices per thread
+    parallelFor(0, dd, [&](int first, int last) {
+        std::vector<float> xPass((size_t)dw * h);
+        std::vector<float> slice((size_t)dw * dh);
+
+        for (int z = first; z < last; z++) {
+            std::fill(slice.begin(), slice.end(), 0.f);
+
+            for (int k = 0; k < 4; k++) {
+                int sz = glm::clamp(2 * z - 1 + k, 0, d - 1);
+                const T *plane = in + (size_t)sz * w * h;
+
+                for (int y = 0; y < h; y++) {
+                    for (int x = 0; x < dw; x++) {
+                        float sum = 0.f;
+
+                        for (int i = 0; i < 4; i++) {
+                            sum += weights[i] * plane[glm::clamp(2 * x - 1 + i, 0, w - 1) + (size_t)y * w];
+                        }
+
+                        xPass[x + (size_t)y * dw] = sum;
+                    }
+                }
+
+                for (int y = 0; y < dh; y++) {
+                    for (int x = 0; x < dw; x++) {
+                        float sum = 0.f;
+
+                        for (int j = 0; j < 4; j++) {
+                            sum += weights[j] * xPass[x + (size_t)glm::clamp(2 * y - 1 + j, 0, h - 1) * dw];
+                        }
+
+                        slice[x + (size_t)y * dw] += weights[k] * sum;
+                    }
+                }
+            }
+
+            T *outSlice = out + (size_t)z * dw * dh;
+
+            for (size_t i = 0; i < slice.size(); i++) {
+                outSlice[i] = std::numeric_limits<T>::is_integer ? (T)std::min(maxValue, slice[i] + 0.5f) : (T)slice[i];
+            }
+        }
+    });
+}
+
+void VolumePyramid::downsample(const VolumeData &src, VolumeData &dst)
+{
+    switch (src.type()) {
+        case VolumeData::UInt16:
+            downsampleVolume<unsigned short>(src, dst);
+            break;
+
+        case VolumeData::Float32:
+            downsampleVolume<float>(src, dst);
+            break;
+
+        default:
+            downsampleVolume<unsigned char>(src, dst);
+            break;
+    }
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include "Commons.h"
+#include "VolumeData.h"
+
+// resolution levels of a volume, level 0 is the source volume and
+// every following level halves each dimension
+class VolumePyramid {
+    private:
+        const VolumeData *base;
+        std::vector<std::unique_ptr<VolumeData>> coarser;
+
+        VolumePyramid(const VolumePyramid &);
+        VolumePyramid &operator=(const VolumePyramid &);
+    public:
+        // levels are added until the largest dimension reaches minSize
+        static const int DEFAULT_MIN_SIZE = 32;
+
+        void build(const VolumeData &source, int minSize = DEFAULT_MIN_SIZE);
+        // used when the levels come precomputed, i.e from bricked files
+        void setBase(const VolumeData &source);
+        void addLevel(std::unique_ptr<VolumeData> level);
+        void clear();
+
+        int levelCount() const
+        {
+            return base ? 1 + (int)coarser.size() : 0;
+        }
+        const VolumeData &level(int index) const
+        {
+            return index == 0 ? *base : *coarser[index - 1];
+        }
+
+        // 2x downsampling with a separable [1 3 3 1] / 8 filter
+        static void downsample(const VolumeData &src, VolumeData &dst);
+        static glm::ivec3 levelSize(const glm::ivec3 &size, int level);
+        static int levelCountFor(const glm::ivec3 &size, int minSize = DEFAULT_MIN_SIZE);
+        // finest level whose texture, together with all coarser ones, fits in
+        // budgetBytes and whose dimensions are within maxTextureSize
+        static int selectLevel(const glm::ivec3 &size, size_t bytesPerVoxel, int levelCount, size_t budgetBytes, int maxTextureSize);
+
+        VolumePyramid(void);
+        ~VolumePyramid(void);
+};
+
@@ -0,0 +1,62 @@
+#include "VolumeStreamer.h"
+#include "MainData.h"
+
+VolumeStreamer::VolumeStreamer(void)
+{
+    slabCuts = 16;
+    depth = 3;
+    // one core is left for the reader and one for the uploader
+    workers = std::max(1, MainData::AVAILABLE_CORES - 2);
+}
+
+VolumeStreamer::~VolumeStreamer(void)
+{
+}
+
+void VolumeStreamer::run(int numCuts)
+{
+    int slabCount = (numCuts + slabCuts - 1) / slabCuts;
+    BoundedQueue<Slab> readSlabs(depth);
+    BoundedQueue<Slab> convertedSlabs(depth);
+    // disk stage
+    std::thread reader([&] {
+        for (int i = 0; i < slabCount; i++) {
+            Slab slab = { i, i * slabCuts, std::min(slabCuts, numCuts - i * slabCuts) };
+
+            if (read) read(slab);
+
+            readSlabs.push(slab);
+        }
+
+        readSlabs.close();
+    });
+    // conversion stage
+    std::atomic<int> activeWorkers(workers);
+    std::vector<std::thread> converters;
+
+    for (int i = 0; i < workers; i++) {
+        converters.push_back(std::thread([&] {
+            Slab slab;
+
+            while (readSlabs.pop(slab)) {
+                if (convert) convert(slab);
+
+                convertedSlabs.push(slab);
+            }
+
+            // last worker out closes the upload queue
+            if (--activeWorkers == 0) convertedSlabs.close();
+        }));
+    }
+
+    // upload stage, stays on the gl thread
+    Slab slab;
+
+    while (convertedSlabs.pop(slab)) {
+        if (upload) upload(slab);
+    }
+
+    reader.join();
+
+    for (auto &t : converters) t.join();
+}
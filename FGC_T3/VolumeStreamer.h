@@ -0,0 +1,32 @@
+#pragma once
+#include "Commons.h"
+#include "BoundedQueue.h"
+
+// three stage pipeline that moves a volume in z slabs from disk to the gpu,
+// read runs on its own thread, convert on a pool of workers and upload on
+// the thread calling run. every queue between stages is bounded so at most
+// depth slabs are in flight per stage
+class VolumeStreamer {
+    public:
+        struct Slab {
+            int index;
+            int firstCut;
+            int cutCount;
+        };
+
+        std::function<void(const Slab &)> read;
+        std::function<void(const Slab &)> convert;
+        std::function<void(const Slab &)> upload;
+
+        // z slices per slab
+        int slabCuts;
+        // slabs buffered between two stages, 2 double and 3 triple buffering
+        int depth;
+        int workers;
+
+        void run(int numCuts);
+
+        VolumeStreamer(void);
+        ~VolumeStreamer(void);
+};
+
@@ -0,0 +1,407 @@
+#include "VoxelConverter.h"
+#include "Parallel.h"
+#include <intrin.h>
+#include <immintrin.h>
+#include <chrono>
+
+VoxelConverter::Params VoxelConverter::makeParams(VolumeData::VoxelType type, bool isSigned, bool byteSwap, const glm::vec2 &range,
+        const glm::vec2 &window)
+{
+    Params params;
+    params.type = type;
+    params.isSigned = isSigned;
+    params.byteSwap = byteSwap;
+    params.windowed = !isIdentityWindow(window);
+    float width = std::max(window.y - window.x, 1e-6f);
+
+    if (type == VolumeData::Float32) {
+        // both the range and the window are folded into one affine map
+        float extent = range.y > range.x ? range.y - range.x : 1.f;
+        params.low = range.x + window.x * extent;
+        params.scale = 1.f / (width * extent);
+    } else {
+        float maxValue = type == VolumeData::UInt16 ? 65535.f : 255.f;
+        params.low = window.x * maxValue;
+        params.scale = 1.f / width;
+    }
+
+    return params;
+}
+
+static float readFloat(const unsigned char *src, bool byteSwap)
+{
+    unsigned int bits;
+    memcpy(&bits, src, sizeof(bits));
+
+    if (byteSwap) {
+        bits = (bits >> 24) | ((bits >> 8) & 0xff00) | ((bits << 8) & 0xff0000) | (bits << 24);
+    }
+
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+glm::vec2 VoxelConverter::floatRange(const void *src, size_t count, bool byteSwap)
+{
+    const unsigned char *in = (const unsigned char *)src;
+    const size_t block = 1 << 20;
+    std::mutex mutex;
+    glm::vec2 range(std::numeric_limits<float>::max(), -std::numeric_limits<float>::max());
+    parallelFor(0, (int)((count + block - 1) / block), [&](int first, int last) {
+        glm::vec2 local = range;
+
+        for (size_t i = first * block; i < std::min(count, last * block); i++) {
+            float value = readFloat(in + i * sizeof(float), byteSwap);
+            local = glm::vec2(std::min(local.x, value), std::max(local.y, value));
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        range = glm::vec2(std::min(range.x, local.x), std::max(range.y, local.y));
+    });
+    return range;
+}
+
+VoxelConverter::Isa VoxelConverter::detectIsa()
+{
+    static int detected = -1;
+
+    if (detected >= 0) return (Isa)detected;
+
+    int info[4];
+    __cpuid(info, 0);
+    int maxLeaf = info[0];
+    __cpuid(info, 1);
+    bool sse2 = (info[3] & (1 << 26)) != 0;
+    // avx needs os support for the ymm registers too
+    bool avx = (info[2] & (1 << 27)) != 0 && (info[2] & (1 << 28)) != 0 && (_xgetbv(0) & 6) == 6;
+    bool avx2 = false;
+
+    if (avx && maxLeaf >= 7) {
+        __cpuidex(info, 7, 0);
+        avx2 = (info[1] & (1 << 5)) != 0;
+    }
+
+    detected = avx2 ? AVX2 : sse2 ? SSE2 : Scalar;
+    return (Isa)detected;
+}
+
+const char *VoxelConverter::isaName(Isa isa)
+{
+    switch (isa) {
+        case SSE2:
+            return "sse2";
+
+        case AVX2:
+            return "avx2";
+
+        default:
+            return "scalar";
+    }
+}
+
+// scalar kernels, also used for the tails of the vector loops
+
+static void convert8Scalar(const VoxelConverter::Params &p, const unsigned char *src, unsigned char *dst, size_t count)
+{
+    unsigned char flip = p.isSigned ? 0x80 : 0;
+
+    for (size_t i = 0; i < count; i++) {
+        unsigned char value = src[i] ^ flip;
+        dst[i] = p.windowed ? (unsigned char)glm::clamp((value - p.low) * p.scale + 0.5f, 0.f, 255.f) : value;
+    }
+}
+
+static void convert16Scalar(const VoxelConverter::Params &p, const unsigned char *src, unsigned short *dst, size_t count)
+{
+    unsigned short flip = p.isSigned ? 0x8000 : 0;
+
+    for (size_t i = 0; i < count; i++) {
+        unsigned short value = (unsigned short)(src[i * 2] | (src[i * 2 + 1] << 8));
+
+        if (p.byteSwap) value = (unsigned short)((value >> 8) | (value << 8));
+
+        value ^= flip;
+        dst[i] = p.windowed ? (unsigned short)glm::clamp((value - p.low) * p.scale + 0.5f, 0.f, 65535.f) : value;
+    }
+}
+
+static void convertFloatScalar(const VoxelConverter::Params &p, const unsigned char *src, float *dst, size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        dst[i] = glm::clamp((readFloat(src + i * sizeof(float), p.byteSwap) - p.low) * p.scale, 0.f, 1.f);
+    }
+}
+
+// sse2 kernels
+
+static __m128i windowSSE2(__m128i values, __m128 low, __m128 scale, __m128 maxValue)
+{
+    __m128 v = _mm_cvtepi32_ps(values);
+    v = _mm_add_ps(_mm_mul_ps(_mm_sub_ps(v, low), scale), _mm_set1_ps(0.5f));
+    v = _mm_min_ps(_mm_max_ps(v, _mm_setzero_ps()), maxValue);
+    return _mm_cvttps_epi32(v);
+}
+
+static void convert8SSE2(const VoxelConverter::Params &p, const unsigned char *src, unsigned char *dst, size_t count)
+{
+    __m128i flip = _mm_set1_epi8(p.isSigned ? (char)0x80 : 0);
+    __m128 low = _mm_set1_ps(p.low), scale = _mm_set1_ps(p.scale), maxValue = _mm_set1_ps(255.f);
+    __m128i zero = _mm_setzero_si128();
+    size_t i = 0;
+
+    for (; i + 16 <= count; i += 16) {
+        __m128i v = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(src + i)), flip);
+
+        if (p.windowed) {
+            __m128i lo = _mm_unpacklo_epi8(v, zero), hi = _mm_unpackhi_epi8(v, zero);
+            __m128i a = windowSSE2(_mm_unpacklo_epi16(lo, zero), low, scale, maxValue);
+            __m128i b = windowSSE2(_mm_unpackhi_epi16(lo, zero), low, scale, maxValue);
+            __m128i c = windowSSE2(_mm_unpacklo_epi16(hi, zero), low, scale, maxValue);
+            __m128i d = windowSSE2(_mm_unpackhi_epi16(hi, zero), low, scale, maxValue);
+            v = _mm_packus_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(c, d));
+        }
+
+        _mm_storeu_si128((__m128i *)(dst + i), v);
+    }
+
+    convert8Scalar(p, src + i, dst + i, count - i);
+}
+
+// sse2 has no unsigned 32 to 16 bit pack, the values are biased into the signed range
+static __m128i packUnsigned32SSE2(__m128i a, __m128i b)
+{
+    __m128i bias = _mm_set1_epi32(0x8000);
+    __m128i packed = _mm_packs_epi32(_mm_sub_epi32(a, bias), _mm_sub_epi32(b, bias));
+    return _mm_xor_si128(packed, _mm_set1_epi16((short)0x8000));
+}
+
+static void convert16SSE2(const VoxelConverter::Params &p, const unsigned char *src, unsigned short *dst, size_t count)
+{
+    __m128i flip = _mm_set1_epi16(p.isSigned ? (short)0x8000 : 0);
+    __m128 low = _mm_set1_ps(p.low), scale = _mm_set1_ps(p.scale), maxValue = _mm_set1_ps(65535.f);
+    __m128i zero = _mm_setzero_si128();
+    size_t i = 0;
+
+    for (; i + 8 <= count; i += 8) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(src + i * 2));
+
+        if (p.byteSwap) v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+
+        v = _mm_xor_si128(v, flip);
+
+        if (p.windowed) {
+            __m128i a = windowSSE2(_mm_unpacklo_epi16(v, zero), low, scale, maxValue);
+            __m128i b = windowSSE2(_mm_unpackhi_epi16(v, zero), low, scale, maxValue);
+            v = packUnsigned32SSE2(a, b);
+        }
+
+        _mm_storeu_si128((__m128i *)(dst + i), v);
+    }
+
+    convert16Scalar(p, src + i * 2, dst + i, count - i);
+}
+
+static void convertFloatSSE2(const VoxelConverter::Params &p, const unsigned char *src, float *dst, size_t count)
+{
+    __m128 low = _mm_set1_ps(p.low), scale = _mm_set1_ps(p.scale), one = _mm_set1_ps(1.f);
+    __m128i mask = _mm_set1_epi32(0xff00);
+    size_t i = 0;
+
+    for (; i + 4 <= count; i += 4) {
+        __m128i bits = _mm_loadu_si128((const __m128i *)(src + i * 4));
+
+        if (p.byteSwap) {
+            bits = _mm_or_si128(_mm_or_si128(_mm_slli_epi32(bits, 24), _mm_srli_epi32(bits, 24)),
+                                _mm_or_si128(_mm_and_si128(_mm_srli_epi32(bits, 8), mask), _mm_slli_epi32(_mm_and_si128(bits, mask), 8)));
+        }
+
+        __m128 v = _mm_mul_ps(_mm_sub_ps(_mm_castsi128_ps(bits), low), scale);
+        _mm_storeu_ps(dst + i, _mm_min_ps(_mm_max_ps(v, _mm_setzero_ps()), one));
+    }
+
+    convertFloatScalar(p, src + i * 4, dst + i, count - i);
+}
+
+// avx2 kernels, msvc emits them without /arch so they only run after detection.
+// each clears the upper halves before its scalar tail, legacy sse code after
+// dirty ymm registers pays a state transition on every instruction
+
+static __m256i windowAVX2(__m256i values, __m256 low, __m256 scale, __m256 maxValue)
+{
+    __m256 v = _mm256_cvtepi32_ps(values);
+    v = _mm256_add_ps(_mm256_mul_ps(_mm256_sub_ps(v, low), scale), _mm256_set1_ps(0.5f));
+    v = _mm256_min_ps(_mm256_max_ps(v, _mm256_setzero_ps()), maxValue);
+    return _mm256_cvttps_epi32(v);
+}
+
+static void convert8AVX2(const VoxelConverter::Params &p, const unsigned char *src, unsigned char *dst, size_t count)
+{
+    __m256i flip = _mm256_set1_epi8(p.isSigned ? (char)0x80 : 0);
+    __m256 low = _mm256_set1_ps(p.low), scale = _mm256_set1_ps(p.scale), maxValue = _mm256_set1_ps(255.f);
+    size_t i = 0;
+
+    if (!p.windowed) {
+        for (; i + 32 <= count; i += 32) {
+            __m256i v = _mm256_loadu_si256((const __m256i *)(src + i));
+            _mm256_storeu_si256((__m256i *)(dst + i), _mm256_xor_si256(v, flip));
+        }
+    } else {
+        for (; i + 16 <= count; i += 16) {
+            __m128i v = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(src + i)), _mm256_castsi256_si128(flip));
+            __m256i a = windowAVX2(_mm256_cvtepu8_epi32(v), low, scale, maxValue);
+            __m256i b = windowAVX2(_mm256_cvtepu8_epi32(_mm_srli_si128(v, 8)), low, scale, maxValue);
+            // packs works per 128 bit lane, the permute restores the order
+            __m256i words = _mm256_permute4x64_epi64(_mm256_packs_epi32(a, b), 0xd8);
+            __m128i bytes = _mm_packus_epi16(_mm256_castsi256_si128(words), _mm256_extracti128_si256(words, 1));
+            _mm_storeu_si128((__m128i *)(dst + i), bytes);
+        }
+    }
+
+    _mm256_zeroupper();
+    convert8Scalar(p, src + i, dst + i, count - i);
+}
+
+static void convert16AVX2(const VoxelConverter::Params &p, const unsigned char *src, unsigned short *dst, size_t count)
+{
+    __m256i flip = _mm256_set1_epi16(p.isSigned ? (short)0x8000 : 0);
+    __m256i swap = _mm256_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14,
+                                    1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+    __m256 low = _mm256_set1_ps(p.low), scale = _mm256_set1_ps(p.scale), maxValue = _mm256_set1_ps(65535.f);
+    size_t i = 0;
+
+    for (; i + 16 <= count; i += 16) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(src + i * 2));
+
+        if (p.byteSwap) v = _mm256_shuffle_epi8(v, swap);
+
+        v = _mm256_xor_si256(v, flip);
+
+        if (p.windowed) {
+            __m256i a = windowAVX2(_mm256_cvtepu16_epi32(_mm256_castsi256_si128(v)), low, scale, maxValue);
+            __m256i b = windowAVX2(_mm256_cvtepu16_epi32(_mm256_extracti128_si256(v, 1)), low, scale, maxValue);
+            v = _mm256_permute4x64_epi64(_mm256_packus_epi32(a, b), 0xd8);
+        }
+
+        _mm256_storeu_si256((__m256i *)(dst + i), v);
+    }
+
+    _mm256_zeroupper();
+    convert16Scalar(p, src + i * 2, dst + i, count - i);
+}
+
+static void convertFloatAVX2(const VoxelConverter::Params &p, const unsigned char *src, float *dst, size_t count)
+{
+    __m256i swap = _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+                                    3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+    __m256 low = _mm256_set1_ps(p.low), scale = _mm256_set1_ps(p.scale), one = _mm256_set1_ps(1.f);
+    size_t i = 0;
+
+    for (; i + 8 <= count; i += 8) {
+        __m256i bits = _mm256_loadu_si256((const __m256i *)(src + i * 4));
+
+        if (p.byteSwap) bits = _mm256_shuffle_epi8(bits, swap);
+
+        __m256 v = _mm256_mul_ps(_mm256_sub_ps(_mm256_castsi256_ps(bits), low), scale);
+        _mm256_storeu_ps(dst + i, _mm256_min_ps(_mm256_max_ps(v, _mm256_setzero_ps()), one));
+    }
+
+    _mm256_zeroupper();
+    convertFloatScalar(p, src + i * 4, dst + i, count - i);
+}
+
+void VoxelConverter::convert(const Params &params, const void *src, void *dst, size_t count)
+{
+    convert(detectIsa(), params, src, dst, count);
+}
+
+void VoxelConverter::convert(Isa isa, const Params &params, const void *src, void *dst, size_t count)
+{
+    const unsigned char *in = (const unsigned char *)src;
+
+    switch (params.type) {
+        case VolumeData::UInt16: {
+            unsigned short *out = (unsigned short *)dst;
+
+            if (isa == AVX2) convert16AVX2(params, in, out, count);
+            else if (isa == SSE2) convert16SSE2(params, in, out, count);
+            else convert16Scalar(params, in, out, count);
+
+            break;
+        }
+
+        case VolumeData::Float32: {
+            float *out = (float *)dst;
+
+            if (isa == AVX2) convertFloatAVX2(params, in, out, count);
+            else if (isa == SSE2) convertFloatSSE2(params, in, out, count);
+            else convertFloatScalar(params, in, out, count);
+
+            break;
+        }
+
+        default: {
+            unsigned char *out = (unsigned char *)dst;
+
+            if (isa == AVX2) convert8AVX2(params, in, out, count);
+            else if (isa == SSE2) convert8SSE2(params, in, out, count);
+            else convert8Scalar(params, in, out, count);
+
+            break;
+        }
+    }
+}
+
+void VoxelConverter::benchmark()
+{
+    struct Case {
+        const char *name;
+        VolumeData::VoxelType type;
+        bool isSigned;
+        bool byteSwap;
+        glm::vec2 window;
+    };
+    const Case cases[] = {
+        { "u8", VolumeData::UInt8, false, false, glm::vec2(0.f, 1.f) },
+        { "u8 window", VolumeData::UInt8, false, false, glm::vec2(0.2f, 0.6f) },
+        { "u16", VolumeData::UInt16, false, false, glm::vec2(0.f, 1.f) },
+        { "u16 swap", VolumeData::UInt16, false, true, glm::vec2(0.f, 1.f) },
+        { "i16", VolumeData::UInt16, true, false, glm::vec2(0.f, 1.f) },
+        { "i16 window", VolumeData::UInt16, true, false, glm::vec2(0.2f, 0.6f) },
+        { "f32", VolumeData::Float32, false, false, glm::vec2(0.f, 1.f) },
+        { "f32 swap", VolumeData::Float32, false, true, glm::vec2(0.2f, 0.6f) }
+    };
+    const size_t bytes = 64 << 20;
+    const int runs = 10;
+    std::vector<unsigned char> src(bytes), dst(bytes), reference(bytes);
+    unsigned int seed = 12345;
+
+    for (size_t i = 0; i < bytes; i++) {
+        seed = seed * 1664525u + 1013904223u;
+        // keeps the float exponents sane in both byte orders, nan inputs would skew the timing
+        src[i] = (unsigned char)(i % 4 == 0 || i % 4 == 3 ? 0x3f : seed >> 24);
+    }
+
+    std::cout << "--- Voxel conversion, " << (bytes >> 20) << " MB per run" << std::endl;
+
+    for (const Case &c : cases) {
+        Params params = makeParams(c.type, c.isSigned, c.byteSwap, glm::vec2(0.f, 2.f), c.window);
+        size_t count = bytes / VolumeData::bytesPerVoxel(c.type);
+        convert(Scalar, params, &src[0], &reference[0], count);
+
+        for (int isa = Scalar; isa <= detectIsa(); isa++) {
+            // warm up, also checked against the scalar output
+            convert((Isa)isa, params, &src[0], &dst[0], count);
+            bool matches = memcmp(&dst[0], &reference[0], bytes) == 0;
+            auto start = std::chrono::high_resolution_clock::now();
+
+            for (int r = 0; r < runs; r++) {
+                convert((Isa)isa, params, &src[0], &dst[0], count);
+            }
+
+            double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+            std::cout << c.name << "\t" << isaName((Isa)isa) << "\t" << bytes * (double)runs / seconds / 1e9 << " GB/s"
+                      << (matches ? "" : "\tmismatch") << std::endl;
+        }
+    }
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include "Commons.h"
+#include "VolumeData.h"
+
+// converts voxels read from a file into their texture storage, byte
+// swapping, moving signed values to the unsigned range and remapping a
+// value window in a single pass. every kernel exists as scalar, sse2 and
+// avx2 code, the best one the cpu supports is picked at runtime
+class VoxelConverter {
+    public:
+        enum Isa {
+            Scalar,
+            SSE2,
+            AVX2
+        };
+
+        struct Params {
+            // input and output have the same width, signed input is
+            // written as unsigned, floats are written normalized
+            VolumeData::VoxelType type;
+            bool isSigned;
+            bool byteSwap;
+            // output = clamp((input - low) * scale), integers only apply it
+            // when windowed is set, floats always do
+            bool windowed;
+            float low;
+            float scale;
+        };
+
+        // range is the raw float range mapped to [0, 1], window the
+        // normalized [low, high] range stretched over the output
+        static Params makeParams(VolumeData::VoxelType type, bool isSigned, bool byteSwap, const glm::vec2 &range,
+                                 const glm::vec2 &window);
+        static bool isIdentityWindow(const glm::vec2 &window)
+        {
+            return window.x <= 0.f && window.y >= 1.f;
+        }
+
+        // min and max of raw float input, nan values are skipped
+        static glm::vec2 floatRange(const void *src, size_t count, bool byteSwap);
+
+        static Isa detectIsa();
+        static const char *isaName(Isa isa);
+        // src and dst may be unaligned but can't overlap
+        static void convert(const Params &params, const void *src, void *dst, size_t count);
+        static void convert(Isa isa, const Params &params, const void *src, void *dst, size_t count);
+        // prints the throughput of every kernel the cpu supports
+        static void benchmark();
+};